@@ -1,13 +1,27 @@
 #pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "symbol.hpp"
+#include "symtab.hpp"
 
 using namespace std;
 
-static int temp_counter = 0;
+inline int temp_counter = 0;
+// 降级表达式时同时活跃的临时值：live_temps 是已经算出、等待另一侧操作数的值，
+// peak_temps 是当前表达式中的最大值
+inline int live_temps = 0, peak_temps = 0;
 
 inline std::string new_temp() {
+    peak_temps = std::max(peak_temps, live_temps + 1);
     return "%" + std::to_string(temp_counter++);
 }
 
@@ -16,25 +30,208 @@ class BaseAST {
    virtual ~BaseAST() = default;
    virtual void Dump() const = 0;
    virtual std::string GenIR() const = 0;
+   // 编译期求值，不是常量表达式时返回 false
+   virtual bool ConstEval(int32_t &value) const { return false; }
+   // 只由整数字面量组成，不用查符号表就能求值
+   virtual bool IsLiteral() const { return false; }
+
+   // 求值需要的临时值个数（Ershov 数），由构造函数自底向上算出
+   int need = 1;
+   // 求值没有副作用（不含调用），可以和兄弟表达式交换求值顺序
+   bool pure = true;
+};
+
+// 二元运算的 Ershov 数：两侧相同时，先算的一侧的结果要在算另一侧时占着一个临时值
+inline void SetBinaryNeed(BaseAST &node, const BaseAST &lhs, const BaseAST &rhs) {
+  node.need = lhs.need == rhs.need ? lhs.need + 1 : std::max(lhs.need, rhs.need);
+  node.pure = lhs.pure && rhs.pure;
+}
+
+// 按 Sethi-Ullman 顺序求两个操作数：需要临时值多的一侧先算，算完只留下一个结果，
+// 再算另一侧时同时活跃的临时值更少。有调用的一侧可能改写另一侧读取的变量，这时保持从左到右
+inline std::pair<std::string, std::string> GenOperands(const BaseAST &lhs, const BaseAST &rhs) {
+  bool rhs_first = rhs.need > lhs.need && lhs.pure && rhs.pure;
+  const BaseAST &first = rhs_first ? rhs : lhs, &second = rhs_first ? lhs : rhs;
+  std::string first_temp = first.GenIR();
+  bool held = first_temp[0] == '%';
+  live_temps += held;
+  std::string second_temp = second.GenIR();
+  live_temps -= held;
+  if (rhs_first) return {second_temp, first_temp};
+  return {first_temp, second_temp};
+}
+
+// 短路运算先把左侧的结果存入内存再求右侧，求右侧时不占着临时值；两侧都不能交换顺序
+inline void SetShortCircuitNeed(BaseAST &node, const BaseAST &lhs, const BaseAST &rhs) {
+  node.need = std::max({lhs.need, rhs.need, 1});
+  node.pure = lhs.pure && rhs.pure;
+}
+
+// 每个完整表达式的 peak_temps，--temp-report 按函数输出
+inline std::vector<int> expr_peaks;
+inline std::ostream *temp_report = nullptr;
+
+// 降级语句中的一个完整表达式
+inline std::string GenExp(const BaseAST &exp) {
+  live_temps = peak_temps = 0;
+  std::string result = exp.GenIR();
+  expr_peaks.push_back(peak_temps);
+  return result;
+}
+
+// 降级时的符号表，函数体和每个 Block 各占一层作用域
+inline ScopedSymbolTable symtab;
+// 当前基本块已经以 ret 结束，之后的语句不可达，不再生成
+inline bool block_terminated = false;
+// 函数内每个名字已经声明过的次数，用于给被遮蔽的同名变量生成不同的 Koopa 名字
+inline std::vector<uint32_t> decl_counts;
+
+// 函数内基本块标号的编号，if/while 和短路运算各取一个，同一语句的几个块共用
+inline int label_counter = 0;
+// 当前所在的 while 的编号，break/continue 跳到最内层循环的块
+inline std::vector<int> loop_stack;
+
+// 在当前位置开始一个新的基本块
+inline void begin_block(const std::string &label) {
+    std::cout << label << ":\n";
+    block_terminated = false;
+}
+
+// 短路求值的 || 和 &&：左侧已经决定结果时跳过右侧，右侧的调用和访存都不会执行。
+// 结果放在一个局部变量里，与 if 一样分出求右侧的块和结尾的块，在结尾的块中取出
+inline std::string GenShortCircuit(const BaseAST &lhs, const BaseAST &rhs, bool is_or) {
+    std::string id = std::to_string(label_counter++);
+    std::string prefix = is_or ? "%lor_" : "%land_";
+    std::string slot = prefix + id, rhs_label = prefix + "rhs_" + id, end_label = prefix + "end_" + id;
+    std::cout << "  " << slot << " = alloc i32\n";
+    std::string lhs_temp = lhs.GenIR();
+    std::string lhs_cmp = new_temp();
+    std::cout << "  " << lhs_cmp << " = ne " << lhs_temp << ", 0\n";
+    std::cout << "  store " << lhs_cmp << ", " << slot << "\n";
+    std::cout << "  br " << lhs_cmp << ", " << (is_or ? end_label : rhs_label) << ", "
+              << (is_or ? rhs_label : end_label) << "\n";
+
+    begin_block(rhs_label);
+    std::string rhs_temp = rhs.GenIR();
+    std::string rhs_cmp = new_temp();
+    std::cout << "  " << rhs_cmp << " = ne " << rhs_temp << ", 0\n";
+    std::cout << "  store " << rhs_cmp << ", " << slot << "\n";
+    std::cout << "  jump " << end_label << "\n";
+
+    begin_block(end_label);
+    std::string result_temp = new_temp();
+    std::cout << "  " << result_temp << " = load " << slot << "\n";
+    return result_temp;
+}
+
+// 局部变量用 % 开头的局部符号，名字是 %_名字_编号。函数和全局变量都是 @ 开头，
+// 临时值是纯数字，基本块标号和参数不以 _ 开头，所以用户起什么名字都不会重名
+inline std::string new_var_name(Symbol ident) {
+    if (decl_counts.size() <= ident) decl_counts.resize(ident + 1, 0);
+    return "%_" + std::string(symbols.Name(ident)) + "_" + std::to_string(decl_counts[ident]++);
+}
+
+// 全局变量的 Koopa 名字就是 @名字
+inline std::string global_var_name(Symbol ident) { return "@" + std::string(symbols.Name(ident)); }
+
+// 函数的签名，参数都是 int
+struct FuncSig {
+    std::string ir_name;
+    uint32_t params;
+    bool returns_int;
 };
 
+// 函数名到签名，函数定义时加入；运行时库的函数第一次调用时加入
+inline std::unordered_map<Symbol, FuncSig> func_sigs;
+// 正在生成的函数
+inline Symbol current_func;
+
+// 运行时库中参数和返回值都是 int 的函数，每个 Koopa 程序开头都声明它们
+inline const FuncSig kLibraryFuncs[] = {
+    {"@getint", 0, true}, {"@getch", 0, true}, {"@putint", 1, false},
+    {"@putch", 1, false}, {"@starttime", 0, false}, {"@stoptime", 0, false},
+};
+
+inline std::string func_decl(const FuncSig &sig) {
+    std::string decl = "decl " + sig.ir_name + "(";
+    for (uint32_t i = 0; i < sig.params; ++i) decl += i ? ", i32" : "i32";
+    return decl + (sig.returns_int ? "): i32\n" : ")\n");
+}
+
+inline std::string library_decls() {
+    std::string decls;
+    for (const auto &sig : kLibraryFuncs) decls += func_decl(sig);
+    return decls;
+}
+
+inline const FuncSig *lookup_func(Symbol ident) {
+    auto it = func_sigs.find(ident);
+    if (it != func_sigs.end()) return &it->second;
+    std::string name = "@" + std::string(symbols.Name(ident));
+    for (const auto &sig : kLibraryFuncs) {
+        if (sig.ir_name == name) return &(func_sigs[ident] = sig);
+    }
+    return nullptr;
+}
+
+// 当前函数用到的全局变量及其类型，以及调用的其他函数。逐函数生成 RISC-V 时每个函数的 IR
+// 单独解析，需要在前面补上这些全局变量和函数的声明
+inline std::map<std::string, std::string> used_globals;
+inline std::map<std::string, std::string> used_funcs;
+
+inline void use_global(const SymbolInfo &info) {
+    if (info.depth != 0) return;
+    if (info.kind == SymbolInfo::kVar) used_globals.emplace(info.ir_name, "i32");
+    else used_globals.emplace(info.ir_name, "[i32, " + std::to_string(info.value) + "]");
+}
+
+// 用到的全局变量和函数的声明。全局变量的初值一律写 zeroinit，数据由全局变量自己的声明生成
+inline std::string used_decls() {
+    std::string decls;
+    for (const auto &[name, type] : used_globals) decls += "global " + name + " = alloc " + type + ", zeroinit\n";
+    for (const auto &[name, decl] : used_funcs) decls += decl;
+    return decls;
+}
+
+// 全局数组的数据。values 是初始化列表中按下标排列的值，没有初始化列表时为空，
+// patches 是不是字面量的元素求值后的结果
+struct ArrayData {
+    std::string name;
+    uint32_t len;
+    const std::vector<int32_t> *values;
+    std::vector<std::pair<uint32_t, int32_t>> patches;
+};
+
+// 设置后全局数组不写进 Koopa IR，初值直接记入 array_data，由调用者生成数据段，
+// 避免把巨大的初始化列表先写成 aggregate 再解析回来
+inline bool collect_array_data = false;
+inline std::vector<ArrayData> array_data;
+
+// 设置后，CompUnitAST 不再保存顶层的函数定义和全局声明，而是在每一项归约完成时交给它处理
+using ItemSink = std::function<void(std::unique_ptr<BaseAST>)>;
+inline ItemSink item_sink;
+
 class CompUnitAST : public BaseAST {
   public:
-   std::unique_ptr<BaseAST> func_def;
+   std::vector<std::unique_ptr<BaseAST>> items;
 
-   CompUnitAST(std::unique_ptr<BaseAST> func_def) : func_def(std::move(func_def)) {}
+   void AddItem(std::unique_ptr<BaseAST> item) {
+    if (item_sink) item_sink(std::move(item));
+    else items.push_back(std::move(item));
+  }
 
    void Dump() const override {
     std::cout << "CompUnitAST { ";
-    func_def->Dump();
+    for (size_t i = 0; i < items.size(); ++i) {
+      if (i) std::cout << ", ";
+      items[i]->Dump();
+    }
     std::cout << " }";
   }
 
   std::string GenIR() const override {
-    std::cout << "fun @main(): i32 {\n";
-    std::cout << "%entry:\n";
-    func_def->GenIR();
-    std::cout << "}\n";
+    std::cout << library_decls();
+    for (const auto &item : items) item->GenIR();
     return "";
   }
 };
@@ -42,22 +239,63 @@ class CompUnitAST : public BaseAST {
 class FuncDefAST : public BaseAST {
   public:
    std::unique_ptr<BaseAST> func_type;
-   std::string ident;
+   Symbol ident;
+   std::vector<Symbol> params;
    std::unique_ptr<BaseAST> block;
 
-   FuncDefAST(std::unique_ptr<BaseAST> func_type, std::string ident, std::unique_ptr<BaseAST> block)
-      : func_type(std::move(func_type)), ident(std::move(ident)), block(std::move(block)) {}
+   FuncDefAST(std::unique_ptr<BaseAST> func_type, Symbol ident, std::vector<Symbol> params,
+              std::unique_ptr<BaseAST> block)
+      : func_type(std::move(func_type)), ident(ident), params(std::move(params)), block(std::move(block)) {}
 
    void Dump() const override {
     std::cout << "FuncDefAST { ";
     func_type->Dump();
-    std::cout << ", " << ident << ", ";
+    std::cout << ", " << symbols.Name(ident) << ", (";
+    for (size_t i = 0; i < params.size(); ++i) std::cout << (i ? ", " : "") << symbols.Name(params[i]);
+    std::cout << "), ";
     block->Dump();
     std::cout << " }";
   }
 
+  // 临时变量编号只在函数内有效，每个函数从 %0 开始。
+  // 参数先存进各自的局部变量，参数占函数体外的一层作用域
   std::string GenIR() const override {
-    return block->GenIR();
+    temp_counter = 0;
+    label_counter = 0;
+    block_terminated = false;
+    decl_counts.clear();
+    used_globals.clear();
+    used_funcs.clear();
+    expr_peaks.clear();
+    std::string ret_type = func_type->GenIR();
+    std::string name = "@" + std::string(symbols.Name(ident));
+    func_sigs[ident] = {name, static_cast<uint32_t>(params.size()), !ret_type.empty()};
+    current_func = ident;
+    std::cout << "fun " << name << "(";
+    for (size_t i = 0; i < params.size(); ++i) std::cout << (i ? ", " : "") << "%arg" << i << ": i32";
+    std::cout << ")";
+    if (!ret_type.empty()) std::cout << ": " << ret_type;
+    std::cout << " {\n";
+    std::cout << "%entry:\n";
+    symtab.PushScope();
+    for (size_t i = 0; i < params.size(); ++i) {
+      std::string var = new_var_name(params[i]);
+      std::cout << "  " << var << " = alloc i32\n";
+      std::cout << "  store %arg" << i << ", " << var << "\n";
+      symtab.Declare(params[i], {SymbolInfo::kVar, 0, var, 0});
+    }
+    block->GenIR();
+    symtab.PopScope();
+    // 控制流走到函数末尾时补上返回
+    if (!block_terminated) std::cout << (ret_type.empty() ? "  ret\n" : "  ret 0\n");
+    std::cout << "}\n";
+    if (temp_report) {
+      *temp_report << "function " << name.substr(1) << ": expressions " << expr_peaks.size() << ", max peak "
+                    << (expr_peaks.empty() ? 0 : *std::max_element(expr_peaks.begin(), expr_peaks.end())) << ", peaks";
+      for (int peak : expr_peaks) *temp_report << " " << peak;
+      *temp_report << "\n";
+    }
+    return "";
   }
 };
 
@@ -72,24 +310,31 @@ class FuncTypeAST : public BaseAST {
   }
 
   std::string GenIR() const override {
-    return "";
+    return type == "int" ? "i32" : "";
   }
 };
 
 class BlockAST : public BaseAST {
   public:
-   std::unique_ptr<BaseAST> stmt;
-
-   BlockAST(std::unique_ptr<BaseAST> stmt) : stmt(std::move(stmt)) {}
+   std::vector<std::unique_ptr<BaseAST>> items;
 
    void Dump() const override {
     std::cout << "BlockAST { ";
-    stmt->Dump();
+    for (size_t i = 0; i < items.size(); ++i) {
+      if (i) std::cout << ", ";
+      items[i]->Dump();
+    }
     std::cout << " }";
   }
 
   std::string GenIR() const override {
-    return stmt->GenIR();
+    symtab.PushScope();
+    for (const auto &item : items) {
+      if (block_terminated) break;
+      item->GenIR();
+    }
+    symtab.PopScope();
+    return "";
   }
 };
 
@@ -100,23 +345,447 @@ class StmtAST : public BaseAST {
    StmtAST(std::unique_ptr<BaseAST> number) : number(std::move(number)) {}
 
    void Dump() const override {
-    std::cout << "StmtAST { return ";
-    number->Dump();
+    std::cout << "StmtAST { return";
+    if (number) {
+      std::cout << " ";
+      number->Dump();
+    }
     std::cout << "; }";
   }
 
    std::string GenIR() const override {
-    std::string result = number->GenIR();
+    bool returns_int = func_sigs.at(current_func).returns_int;
+    if (!number) {
+      // 与控制流走到函数末尾一样，int 函数中的 return; 返回 0
+      std::cout << (returns_int ? "  ret 0\n" : "  ret\n");
+      block_terminated = true;
+      return "";
+    }
+    assert(returns_int && "void function returns a value");
+    std::string result = GenExp(*number);
     std::cout << "  ret " << result << "\n";
+    block_terminated = true;
     return result;
   }
 };
 
+class AssignStmtAST : public BaseAST {
+  public:
+   Symbol ident;
+   std::unique_ptr<BaseAST> index;  // 给数组元素赋值时的下标
+   std::unique_ptr<BaseAST> exp;
+
+   AssignStmtAST(Symbol ident, std::unique_ptr<BaseAST> index, std::unique_ptr<BaseAST> exp)
+      : ident(ident), index(std::move(index)), exp(std::move(exp)) {}
+
+   void Dump() const override {
+    std::cout << "AssignStmtAST { " << symbols.Name(ident);
+    if (index) {
+      std::cout << "[";
+      index->Dump();
+      std::cout << "]";
+    }
+    std::cout << " = ";
+    exp->Dump();
+    std::cout << "; }";
+  }
+
+   std::string GenIR() const override {
+    std::string value = GenExp(*exp);
+    const SymbolInfo *info = symtab.Lookup(ident);
+    assert(info && "undefined identifier");
+    assert(info->kind == (index ? SymbolInfo::kArray : SymbolInfo::kVar) && "invalid assignment target");
+    use_global(*info);
+    std::string dest = info->ir_name;
+    if (index) {
+      std::string index_temp = GenExp(*index);
+      dest = new_temp();
+      std::cout << "  " << dest << " = getelemptr " << info->ir_name << ", " << index_temp << "\n";
+    }
+    std::cout << "  store " << value << ", " << dest << "\n";
+    return "";
+  }
+};
+
+// 表达式语句，exp 为空时是空语句
+class ExpStmtAST : public BaseAST {
+  public:
+   std::unique_ptr<BaseAST> exp;
+
+   ExpStmtAST(std::unique_ptr<BaseAST> exp) : exp(std::move(exp)) {}
+
+   void Dump() const override {
+    std::cout << "ExpStmtAST { ";
+    if (exp) exp->Dump();
+    std::cout << "; }";
+  }
+
+   std::string GenIR() const override {
+    if (exp) GenExp(*exp);
+    return "";
+  }
+};
+
+class IfStmtAST : public BaseAST {
+  public:
+   std::unique_ptr<BaseAST> cond;
+   std::unique_ptr<BaseAST> then_stmt;
+   std::unique_ptr<BaseAST> else_stmt;  // 没有 else 时为空
+
+   IfStmtAST(std::unique_ptr<BaseAST> cond, std::unique_ptr<BaseAST> then_stmt,
+             std::unique_ptr<BaseAST> else_stmt)
+      : cond(std::move(cond)), then_stmt(std::move(then_stmt)), else_stmt(std::move(else_stmt)) {}
+
+   void Dump() const override {
+    std::cout << "IfStmtAST { ";
+    cond->Dump();
+    std::cout << ", ";
+    then_stmt->Dump();
+    if (else_stmt) {
+      std::cout << ", ";
+      else_stmt->Dump();
+    }
+    std::cout << " }";
+  }
+
+   std::string GenIR() const override {
+    std::string cond_temp = GenExp(*cond);
+    std::string id = std::to_string(label_counter++);
+    std::string then_label = "%then_" + id, else_label = "%else_" + id, end_label = "%end_" + id;
+    std::cout << "  br " << cond_temp << ", " << then_label << ", "
+              << (else_stmt ? else_label : end_label) << "\n";
+
+    begin_block(then_label);
+    then_stmt->GenIR();
+    bool then_returns = block_terminated;
+    if (!block_terminated) std::cout << "  jump " << end_label << "\n";
+    if (!else_stmt) {
+      begin_block(end_label);
+      return "";
+    }
+
+    begin_block(else_label);
+    else_stmt->GenIR();
+    // 两个分支都不会走到结尾时，结尾的块不可达，不生成
+    if (then_returns && block_terminated) return "";
+    if (!block_terminated) std::cout << "  jump " << end_label << "\n";
+    begin_block(end_label);
+    return "";
+  }
+};
+
+class WhileStmtAST : public BaseAST {
+  public:
+   std::unique_ptr<BaseAST> cond;
+   std::unique_ptr<BaseAST> body;
+
+   WhileStmtAST(std::unique_ptr<BaseAST> cond, std::unique_ptr<BaseAST> body)
+      : cond(std::move(cond)), body(std::move(body)) {}
+
+   void Dump() const override {
+    std::cout << "WhileStmtAST { ";
+    cond->Dump();
+    std::cout << ", ";
+    body->Dump();
+    std::cout << " }";
+  }
+
+   std::string GenIR() const override {
+    int id = label_counter++;
+    std::string entry_label = "%while_entry_" + std::to_string(id);
+    std::string body_label = "%while_body_" + std::to_string(id);
+    std::string end_label = "%while_end_" + std::to_string(id);
+    std::cout << "  jump " << entry_label << "\n";
+
+    begin_block(entry_label);
+    std::string cond_temp = GenExp(*cond);
+    std::cout << "  br " << cond_temp << ", " << body_label << ", " << end_label << "\n";
+
+    begin_block(body_label);
+    loop_stack.push_back(id);
+    body->GenIR();
+    loop_stack.pop_back();
+    if (!block_terminated) std::cout << "  jump " << entry_label << "\n";
+
+    begin_block(end_label);
+    return "";
+  }
+};
+
+// break 和 continue，is_break 为 false 时是 continue
+class LoopJumpStmtAST : public BaseAST {
+  public:
+   bool is_break;
+
+   LoopJumpStmtAST(bool is_break) : is_break(is_break) {}
+
+   void Dump() const override {
+    std::cout << "LoopJumpStmtAST { " << (is_break ? "break" : "continue") << " }";
+  }
+
+   std::string GenIR() const override {
+    assert(!loop_stack.empty() && "break/continue outside of a loop");
+    std::string target = is_break ? "%while_end_" : "%while_entry_";
+    std::cout << "  jump " << target << loop_stack.back() << "\n";
+    block_terminated = true;
+    return "";
+  }
+};
+
+// 常量和变量声明，一条声明可以包含多个定义
+class DeclAST : public BaseAST {
+  public:
+   bool is_const;
+   std::vector<std::unique_ptr<BaseAST>> defs;
+
+   DeclAST(bool is_const) : is_const(is_const) {}
+
+   void Dump() const override {
+    std::cout << "DeclAST { " << (is_const ? "const int " : "int ");
+    for (size_t i = 0; i < defs.size(); ++i) {
+      if (i) std::cout << ", ";
+      defs[i]->Dump();
+    }
+    std::cout << " }";
+  }
+
+   std::string GenIR() const override {
+    for (const auto &def : defs) def->GenIR();
+    return "";
+  }
+};
+
+class ConstDefAST : public BaseAST {
+  public:
+   Symbol ident;
+   std::unique_ptr<BaseAST> init;
+
+   ConstDefAST(Symbol ident, std::unique_ptr<BaseAST> init) : ident(ident), init(std::move(init)) {}
+
+   void Dump() const override {
+    std::cout << "ConstDefAST { " << symbols.Name(ident) << " = ";
+    init->Dump();
+    std::cout << " }";
+  }
+
+   // 常量不分配内存，值记在符号表里
+   std::string GenIR() const override {
+    int32_t value;
+    bool is_const = init->ConstEval(value);
+    assert(is_const && "constant initializer is not a constant expression");
+    symtab.Declare(ident, {SymbolInfo::kConst, value, "", 0});
+    return "";
+  }
+};
+
+class VarDefAST : public BaseAST {
+  public:
+   Symbol ident;
+   std::unique_ptr<BaseAST> init;
+
+   VarDefAST(Symbol ident, std::unique_ptr<BaseAST> init) : ident(ident), init(std::move(init)) {}
+
+   void Dump() const override {
+    std::cout << "VarDefAST { " << symbols.Name(ident);
+    if (init) {
+      std::cout << " = ";
+      init->Dump();
+    }
+    std::cout << " }";
+  }
+
+   std::string GenIR() const override {
+    // 全局变量的初值必须是常量表达式，没有初值时为 0
+    if (symtab.Depth() == 0) {
+      int32_t value = 0;
+      bool is_const = !init || init->ConstEval(value);
+      assert(is_const && "global initializer is not a constant expression");
+      std::string name = global_var_name(ident);
+      std::cout << "global " << name << " = alloc i32, ";
+      if (value) std::cout << value << "\n";
+      else std::cout << "zeroinit\n";
+      symtab.Declare(ident, {SymbolInfo::kVar, 0, name, 0});
+      return "";
+    }
+    // 初始化表达式在新变量可见之前求值，int a = a; 中的 a 指外层的 a
+    std::string value = init ? GenExp(*init) : "";
+    std::string name = new_var_name(ident);
+    std::cout << "  " << name << " = alloc i32\n";
+    if (init) std::cout << "  store " << value << ", " << name << "\n";
+    symtab.Declare(ident, {SymbolInfo::kVar, 0, name, 0});
+    return "";
+  }
+};
+
+// 数组的初始化列表。values 按下标保存每个元素的值；不是字面量的元素记在 exps 中，
+// 对应的 values 项为 0。全是字面量的列表由词法分析器直接读成 values，
+// 不为元素建立语法树结点，values 中每个元素占 4 字节（扫描时 Flex 的缓冲区还要容纳整个列表的原文）
+class InitListAST : public BaseAST {
+  public:
+   std::vector<int32_t> values;
+   std::vector<std::pair<uint32_t, std::unique_ptr<BaseAST>>> exps;
+
+   void Add(std::unique_ptr<BaseAST> exp) {
+    int32_t value = 0;
+    if (exp->IsLiteral()) exp->ConstEval(value);
+    else exps.emplace_back(values.size(), std::move(exp));
+    values.push_back(value);
+  }
+
+   void Dump() const override {
+    std::cout << "InitListAST { ";
+    auto exp = exps.begin();
+    for (size_t i = 0; i < values.size(); ++i) {
+      if (i) std::cout << ", ";
+      if (exp != exps.end() && exp->first == i) (exp++)->second->Dump();
+      else std::cout << values[i];
+    }
+    std::cout << " }";
+  }
+
+   // 由 ArrayDefAST 按元素生成
+   std::string GenIR() const override {
+    assert(false);
+    return "";
+  }
+};
+
+class ArrayDefAST : public BaseAST {
+  public:
+   Symbol ident;
+   bool is_const;
+   std::unique_ptr<BaseAST> len;
+   std::unique_ptr<InitListAST> init;
+
+   ArrayDefAST(Symbol ident, bool is_const, std::unique_ptr<BaseAST> len, std::unique_ptr<InitListAST> init)
+      : ident(ident), is_const(is_const), len(std::move(len)), init(std::move(init)) {}
+
+   void Dump() const override {
+    std::cout << "ArrayDefAST { " << symbols.Name(ident) << "[";
+    len->Dump();
+    std::cout << "]";
+    if (init) {
+      std::cout << " = ";
+      init->Dump();
+    }
+    std::cout << " }";
+  }
+
+   std::string GenIR() const override {
+    int32_t size;
+    bool is_const_len = len->ConstEval(size);
+    assert(is_const_len && size > 0 && "array length is not a positive constant");
+    assert((!init || init->values.size() <= static_cast<uint32_t>(size)) && "too many initializers");
+    SymbolInfo info{is_const ? SymbolInfo::kConstArray : SymbolInfo::kArray, size, "", 0};
+    std::string type = "[i32, " + std::to_string(size) + "]";
+
+    // 全局数组的初值必须是常量表达式
+    if (symtab.Depth() == 0) {
+      info.ir_name = global_var_name(ident);
+      ArrayData data{info.ir_name, static_cast<uint32_t>(size), init ? &init->values : nullptr, {}};
+      bool zero = true;
+      if (init) {
+        for (const auto &[i, exp] : init->exps) {
+          int32_t value;
+          bool is_const_init = exp->ConstEval(value);
+          assert(is_const_init && "global initializer is not a constant expression");
+          data.patches.emplace_back(i, value);
+          zero &= value == 0;
+        }
+        for (int32_t value : init->values) zero &= value == 0;
+      }
+      symtab.Declare(ident, info);
+      if (collect_array_data) {
+        array_data.push_back(std::move(data));
+        return "";
+      }
+      std::cout << "global " << info.ir_name << " = alloc " << type << ", ";
+      if (zero) {
+        std::cout << "zeroinit\n";
+        return "";
+      }
+      auto patch = data.patches.begin();
+      std::cout << "{";
+      for (int32_t i = 0; i < size; ++i) {
+        int32_t value = i < static_cast<int32_t>(init->values.size()) ? init->values[i] : 0;
+        if (patch != data.patches.end() && patch->first == static_cast<uint32_t>(i)) value = (patch++)->second;
+        std::cout << (i ? ", " : "") << value;
+      }
+      std::cout << "}\n";
+      return "";
+    }
+
+    // 局部数组逐个元素存入初值，没有给出的元素补 0
+    info.ir_name = new_var_name(ident);
+    std::cout << "  " << info.ir_name << " = alloc " << type << "\n";
+    if (init) {
+      auto exp = init->exps.begin();
+      for (int32_t i = 0; i < size; ++i) {
+        std::string value;
+        if (exp != init->exps.end() && exp->first == static_cast<uint32_t>(i)) value = GenExp(*(exp++)->second);
+        else value = std::to_string(i < static_cast<int32_t>(init->values.size()) ? init->values[i] : 0);
+        std::string ptr = new_temp();
+        std::cout << "  " << ptr << " = getelemptr " << info.ir_name << ", " << i << "\n";
+        std::cout << "  store " << value << ", " << ptr << "\n";
+      }
+    }
+    symtab.Declare(ident, info);
+    return "";
+  }
+};
+
+class LValAST : public BaseAST {
+  public:
+   Symbol ident;
+   std::unique_ptr<BaseAST> index;  // 数组元素的下标
+
+   LValAST(Symbol ident, std::unique_ptr<BaseAST> index = nullptr) : ident(ident), index(std::move(index)) {
+    if (this->index) {
+      need = std::max(this->index->need, 1);
+      pure = this->index->pure;
+    }
+  }
+
+   void Dump() const override {
+    std::cout << "LValAST(" << symbols.Name(ident);
+    if (index) {
+      std::cout << "[";
+      index->Dump();
+      std::cout << "]";
+    }
+    std::cout << ")";
+  }
+
+   std::string GenIR() const override {
+    const SymbolInfo *info = symtab.Lookup(ident);
+    assert(info && "undefined identifier");
+    if (info->kind == SymbolInfo::kConst) return std::to_string(info->value);
+    assert((info->kind == SymbolInfo::kVar) == !index && "array used without index or scalar indexed");
+    use_global(*info);
+    std::string src = info->ir_name;
+    if (index) {
+      std::string index_temp = index->GenIR();
+      src = new_temp();
+      std::cout << "  " << src << " = getelemptr " << info->ir_name << ", " << index_temp << "\n";
+    }
+    std::string result_temp = new_temp();
+    std::cout << "  " << result_temp << " = load " << src << "\n";
+    return result_temp;
+  }
+
+   bool ConstEval(int32_t &value) const override {
+    const SymbolInfo *info = symtab.Lookup(ident);
+    if (!info || info->kind != SymbolInfo::kConst) return false;
+    value = info->value;
+    return true;
+  }
+};
+
 class NumberAST : public BaseAST {
 public:
     int value;
 
-    NumberAST(int value) : value(value) {}
+    NumberAST(int value) : value(value) { need = 0; }
 
     void Dump() const override {
         std::cout << "Number(" << value << ")";
@@ -126,6 +795,12 @@ public:
     return std::to_string(value);
 }
 
+    bool ConstEval(int32_t &value) const override {
+        value = this->value;
+        return true;
+    }
+
+    bool IsLiteral() const override { return true; }
 };
 
 class UnaryExpAST : public BaseAST {
@@ -134,7 +809,10 @@ public:
     std::unique_ptr<BaseAST> operand; 
 
     UnaryExpAST(char op, std::unique_ptr<BaseAST> operand)
-        : op(op), operand(std::move(operand)) {}
+        : op(op), operand(std::move(operand)) {
+        need = std::max(this->operand->need, op == '+' ? 0 : 1);
+        pure = this->operand->pure;
+    }
 
     void Dump() const override {
         std::cout << "UnaryExpAST(" << op << ", ";
@@ -157,6 +835,58 @@ public:
 
     return operand_temp; 
 }
+
+    bool ConstEval(int32_t &value) const override {
+        if (!operand->ConstEval(value)) return false;
+        if (op == '-') value = -static_cast<uint32_t>(value);
+        else if (op == '!') value = !value;
+        return true;
+    }
+
+    bool IsLiteral() const override { return operand->IsLiteral(); }
+};
+
+class CallExpAST : public BaseAST {
+public:
+    Symbol ident;
+    std::vector<std::unique_ptr<BaseAST>> args;
+
+    CallExpAST(Symbol ident) : ident(ident) { pure = false; }
+
+    void Dump() const override {
+        std::cout << "CallExpAST(" << symbols.Name(ident);
+        for (const auto &arg : args) {
+            std::cout << ", ";
+            arg->Dump();
+        }
+        std::cout << ")";
+    }
+
+    // 实参从左到右求值。没有返回值的函数返回空串
+    std::string GenIR() const override {
+        std::vector<std::string> arg_temps;
+        int held = 0;
+        for (const auto &arg : args) {
+            arg_temps.push_back(arg->GenIR());
+            held += arg_temps.back()[0] == '%';
+            live_temps += arg_temps.back()[0] == '%';
+        }
+        live_temps -= held;
+        const FuncSig *sig = lookup_func(ident);
+        assert(sig && "undefined function");
+        assert(sig->params == args.size() && "wrong number of arguments");
+        if (ident != current_func) used_funcs.emplace(sig->ir_name, func_decl(*sig));
+        std::string result_temp;
+        std::cout << "  ";
+        if (sig->returns_int) {
+            result_temp = new_temp();
+            std::cout << result_temp << " = ";
+        }
+        std::cout << "call " << sig->ir_name << "(";
+        for (size_t i = 0; i < arg_temps.size(); ++i) std::cout << (i ? ", " : "") << arg_temps[i];
+        std::cout << ")\n";
+        return result_temp;
+    }
 };
 
 class RelExpAST : public BaseAST {
@@ -166,7 +896,9 @@ public:
     std::unique_ptr<BaseAST> rhs;
 
     RelExpAST(std::unique_ptr<BaseAST> lhs, std::string op, std::unique_ptr<BaseAST> rhs)
-        : lhs(std::move(lhs)), op(std::move(op)), rhs(std::move(rhs)) {}
+        : lhs(std::move(lhs)), op(std::move(op)), rhs(std::move(rhs)) {
+        SetBinaryNeed(*this, *this->lhs, *this->rhs);
+    }
 
     void Dump() const override {
         std::cout << "RelExpAST(";
@@ -177,8 +909,7 @@ public:
     }
 
     std::string GenIR() const override {
-        std::string lhs_temp = lhs->GenIR();
-        std::string rhs_temp = rhs->GenIR();
+        auto [lhs_temp, rhs_temp] = GenOperands(*lhs, *rhs);
         std::string result_temp = new_temp();
 
         if (op == "<") {
@@ -193,6 +924,16 @@ public:
 
         return result_temp;
     }
+
+    bool ConstEval(int32_t &value) const override {
+        int32_t l, r;
+        if (!lhs->ConstEval(l) || !rhs->ConstEval(r)) return false;
+        if (op == "<") value = l < r;
+        else if (op == "<=") value = l <= r;
+        else if (op == ">") value = l > r;
+        else value = l >= r;
+        return true;
+    }
 };
 
 class EqExpAST : public BaseAST {
@@ -202,7 +943,9 @@ public:
     std::unique_ptr<BaseAST> rhs;
 
     EqExpAST(std::unique_ptr<BaseAST> lhs, std::string op, std::unique_ptr<BaseAST> rhs)
-        : lhs(std::move(lhs)), op(std::move(op)), rhs(std::move(rhs)) {}
+        : lhs(std::move(lhs)), op(std::move(op)), rhs(std::move(rhs)) {
+        SetBinaryNeed(*this, *this->lhs, *this->rhs);
+    }
 
     void Dump() const override {
         std::cout << "EqExpAST(";
@@ -213,8 +956,7 @@ public:
     }
 
     std::string GenIR() const override {
-        std::string lhs_temp = lhs->GenIR();
-        std::string rhs_temp = rhs->GenIR();
+        auto [lhs_temp, rhs_temp] = GenOperands(*lhs, *rhs);
         std::string result_temp = new_temp();
 
         if (op == "==") {
@@ -225,6 +967,13 @@ public:
 
         return result_temp;
     }
+
+    bool ConstEval(int32_t &value) const override {
+        int32_t l, r;
+        if (!lhs->ConstEval(l) || !rhs->ConstEval(r)) return false;
+        value = op == "==" ? l == r : l != r;
+        return true;
+    }
 };
 
 
@@ -234,7 +983,9 @@ public:
     std::unique_ptr<BaseAST> rhs;
 
     LOrExpAST(std::unique_ptr<BaseAST> lhs, std::unique_ptr<BaseAST> rhs)
-        : lhs(std::move(lhs)), rhs(std::move(rhs)) {}
+        : lhs(std::move(lhs)), rhs(std::move(rhs)) {
+        SetShortCircuitNeed(*this, *this->lhs, *this->rhs);
+    }
 
     void Dump() const override {
         std::cout << "LOrExpAST(";
@@ -244,20 +995,14 @@ public:
         std::cout << ")";
     }
 
-    std::string GenIR() const override {
-    std::string lhs_temp = lhs->GenIR();
-    std::string rhs_temp = rhs->GenIR();
-    std::string lhs_cmp = new_temp();
-    std::string rhs_cmp = new_temp();
-    std::string result_temp = new_temp();  
-
-    std::cout << "  " << lhs_cmp << " = ne " << lhs_temp << ", 0\n";
-    std::cout << "  " << rhs_cmp << " = ne " << rhs_temp << ", 0\n";
-    std::cout << "  " << result_temp << " = or " << lhs_cmp << ", " << rhs_cmp << "\n";
-
-    return result_temp;
-}
+    std::string GenIR() const override { return GenShortCircuit(*lhs, *rhs, true); }
 
+    bool ConstEval(int32_t &value) const override {
+        int32_t l, r;
+        if (!lhs->ConstEval(l) || !rhs->ConstEval(r)) return false;
+        value = l || r;
+        return true;
+    }
 };
 
 
@@ -268,7 +1013,9 @@ public:
     std::unique_ptr<BaseAST> rhs;
 
     LAndExpAST(std::unique_ptr<BaseAST> lhs, std::unique_ptr<BaseAST> rhs)
-        : lhs(std::move(lhs)), rhs(std::move(rhs)) {}
+        : lhs(std::move(lhs)), rhs(std::move(rhs)) {
+        SetShortCircuitNeed(*this, *this->lhs, *this->rhs);
+    }
 
     void Dump() const override {
         std::cout << "LAndExpAST(";
@@ -278,21 +1025,14 @@ public:
         std::cout << ")";
     }
 
-    std::string GenIR() const override {
-    std::string lhs_temp = lhs->GenIR();
-    std::string rhs_temp = rhs->GenIR();
-    std::string lhs_cmp = new_temp();
-    std::string rhs_cmp = new_temp();
-    std::string result_temp = new_temp(); 
-
-
-    std::cout << "  " << lhs_cmp << " = ne " << lhs_temp << ", 0\n";
-    std::cout << "  " << rhs_cmp << " = ne " << rhs_temp << ", 0\n";
-    std::cout << "  " << result_temp << " = and " << lhs_cmp << ", " << rhs_cmp << "\n";
-
-    return result_temp;
-}
+    std::string GenIR() const override { return GenShortCircuit(*lhs, *rhs, false); }
 
+    bool ConstEval(int32_t &value) const override {
+        int32_t l, r;
+        if (!lhs->ConstEval(l) || !rhs->ConstEval(r)) return false;
+        value = l && r;
+        return true;
+    }
 };
 
 
@@ -304,7 +1044,9 @@ public:
     std::unique_ptr<BaseAST> rhs;
 
     AddExpAST(std::unique_ptr<BaseAST> lhs, char op, std::unique_ptr<BaseAST> rhs)
-        : lhs(std::move(lhs)), op(op), rhs(std::move(rhs)) {}
+        : lhs(std::move(lhs)), op(op), rhs(std::move(rhs)) {
+        SetBinaryNeed(*this, *this->lhs, *this->rhs);
+    }
 
     void Dump() const override {
         std::cout << "AddExpAST(";
@@ -315,8 +1057,7 @@ public:
     }
 
     std::string GenIR() const override {
-        std::string lhs_temp = lhs->GenIR();
-        std::string rhs_temp = rhs->GenIR();
+        auto [lhs_temp, rhs_temp] = GenOperands(*lhs, *rhs);
         std::string result_temp = new_temp();
 
         if (op == '+') {
@@ -327,6 +1068,13 @@ public:
 
         return result_temp;
     }
+
+    bool ConstEval(int32_t &value) const override {
+        int32_t l, r;
+        if (!lhs->ConstEval(l) || !rhs->ConstEval(r)) return false;
+        value = op == '+' ? static_cast<uint32_t>(l) + r : static_cast<uint32_t>(l) - r;
+        return true;
+    }
 };
 
 class MulExpAST : public BaseAST {
@@ -336,7 +1084,9 @@ public:
     std::unique_ptr<BaseAST> rhs;
 
     MulExpAST(std::unique_ptr<BaseAST> lhs, char op, std::unique_ptr<BaseAST> rhs)
-        : lhs(std::move(lhs)), op(op), rhs(std::move(rhs)) {}
+        : lhs(std::move(lhs)), op(op), rhs(std::move(rhs)) {
+        SetBinaryNeed(*this, *this->lhs, *this->rhs);
+    }
 
     void Dump() const override {
         std::cout << "MulExpAST(";
@@ -347,8 +1097,7 @@ public:
     }
 
     std::string GenIR() const override {
-        std::string lhs_temp = lhs->GenIR();
-        std::string rhs_temp = rhs->GenIR();
+        auto [lhs_temp, rhs_temp] = GenOperands(*lhs, *rhs);
         std::string result_temp = new_temp();
 
         if (op == '*') {
@@ -361,4 +1110,15 @@ public:
 
         return result_temp;
     }
+
+    bool ConstEval(int32_t &value) const override {
+        int32_t l, r;
+        if (!lhs->ConstEval(l) || !rhs->ConstEval(r)) return false;
+        if (op != '*' && r == 0) return false;
+        if (op == '*') value = static_cast<uint32_t>(l) * r;
+        else if (r == -1) value = op == '/' ? -static_cast<uint32_t>(l) : 0;
+        else if (op == '/') value = l / r;
+        else value = l % r;
+        return true;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,243 @@
+#pragma once
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 编译器版本
+#define SYSY_COMPILER_VERSION "0.1.0"
+
+// 读取整个文件，失败返回 false
+inline bool ReadWholeFile(const std::string &path, std::string &data) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+  std::ostringstream ss;
+  ss << in.rdbuf();
+  data = ss.str();
+  return true;
+}
+
+// 与 path 同目录的临时文件名，rename 到 path 是原子的
+inline std::string TempPath(const std::string &path) { return path + ".tmp." + std::to_string(getpid()); }
+
+// path 是普通文件或还不存在时才能用临时文件加 rename 替换它。/dev/null、/dev/stdout 这类
+// 设备和符号链接被 rename 覆盖就成了普通文件，只能直接写
+inline bool CanReplaceFile(const std::string &path) {
+  struct stat st;
+  if (lstat(path.c_str(), &st) != 0) return errno == ENOENT;
+  return S_ISREG(st.st_mode);
+}
+
+// 先写临时文件再 rename，保证并发调用时读者只会看到完整的文件
+inline bool AtomicWriteFile(const std::string &path, const std::string &data) {
+  std::string tmp = TempPath(path);
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    out.write(data.data(), data.size());
+    if (!out) {
+      std::remove(tmp.c_str());
+      return false;
+    }
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+// 写出编译产物：能替换时原子写入，否则直接写
+inline bool WriteOutputFile(const std::string &path, const std::string &data) {
+  if (CanReplaceFile(path)) return AtomicWriteFile(path, data);
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(data.data(), data.size());
+  return bool(out);
+}
+
+// 缓存键：两个独立的 64 位哈希拼成 128 位
+class CacheKey {
+  public:
+   CacheKey() : h1(0xcbf29ce484222325ULL), h2(0x9e3779b97f4a7c15ULL) {}
+
+   void Update(const std::string &data) {
+    for (unsigned char c : data) {
+      h1 = (h1 ^ c) * 0x100000001b3ULL;
+      h2 = Mix(h2 ^ c);
+    }
+    // 加入长度作为分隔，避免 "ab"+"c" 与 "a"+"bc" 冲突
+    uint64_t len = data.size();
+    h1 = (h1 ^ len) * 0x100000001b3ULL;
+    h2 = Mix(h2 ^ len);
+  }
+
+   std::string Hex() const {
+    char buf[33];
+    std::snprintf(buf, sizeof(buf), "%016llx%016llx",
+                  static_cast<unsigned long long>(h1),
+                  static_cast<unsigned long long>(h2));
+    return buf;
+  }
+
+  private:
+   uint64_t h1, h2;
+
+   static uint64_t Mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb3fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+  }
+};
+
+// 编译器的构建标识，参与缓存键的计算。取可执行文件的 inode、大小和修改时间，重新链接后
+// 至少修改时间会变，旧缓存随之失效，而且不用读可执行文件的内容；stat 失败时退回到版本号
+inline const std::string &CompilerBuildId() {
+  static const std::string id = [] {
+    struct stat st;
+    if (stat("/proc/self/exe", &st) != 0) return std::string(SYSY_COMPILER_VERSION);
+    return SYSY_COMPILER_VERSION " " + std::to_string(st.st_ino) + " " + std::to_string(st.st_size) + " " +
+           std::to_string(st.st_mtim.tv_sec) + "." + std::to_string(st.st_mtim.tv_nsec);
+  }();
+  return id;
+}
+
+// 磁盘上的编译缓存，目录结构：
+//   <dir>/objects/<key>  缓存的产物，mtime 即最近使用时间
+//   <dir>/stats          命中/未命中计数和 objects 的总字节数
+//   <dir>/lock           更新 stats 和淘汰时持有的文件锁
+class CompileCache {
+  public:
+   uint64_t hits = 0;
+   uint64_t misses = 0;
+
+   CompileCache(std::string dir, uint64_t max_bytes)
+      : dir(std::move(dir)), max_bytes(max_bytes) {
+    std::error_code ec;
+    std::filesystem::create_directories(ObjectDir(), ec);
+  }
+
+   static std::string MakeKey(const std::string &source, const std::string &mode,
+                              const std::vector<std::string> &flags) {
+    CacheKey key;
+    key.Update(CompilerBuildId());
+    key.Update(mode);
+    for (const auto &flag : flags) key.Update(flag);
+    key.Update(source);
+    return key.Hex();
+  }
+
+   // 命中时把缓存产物复制到 output，并刷新其最近使用时间
+   bool Fetch(const std::string &key, const std::string &output) {
+    std::string data;
+    bool hit = ReadWholeFile(ObjectPath(key), data) && WriteOutputFile(output, data);
+    if (hit) {
+      std::error_code ec;
+      std::filesystem::last_write_time(ObjectPath(key),
+                                       std::filesystem::file_time_type::clock::now(), ec);
+    }
+    if (hit) UpdateStats(true, 0);
+    return hit;
+  }
+
+   // 编译完成后把 output 存入缓存并记一次未命中，总字节数超出容量时按 LRU 淘汰
+   void Store(const std::string &key, const std::string &output) {
+    std::string data;
+    bool stored = ReadWholeFile(output, data) && AtomicWriteFile(ObjectPath(key), data);
+    UpdateStats(false, stored ? data.size() : 0);
+  }
+
+   // 未命中但产物无法存入缓存
+   void CountMiss() { UpdateStats(false, 0); }
+
+   void PrintStats(std::ostream &os) const {
+    os << "cache: " << hits << " hits, " << misses << " misses" << std::endl;
+  }
+
+  private:
+   std::string dir;
+   uint64_t max_bytes;
+
+   std::string ObjectDir() const { return dir + "/objects"; }
+   std::string ObjectPath(const std::string &key) const { return ObjectDir() + "/" + key; }
+
+   // 在 <dir>/lock 上加排他锁，析构时释放
+   class Lock {
+    public:
+     Lock(const std::string &path) : fd(open(path.c_str(), O_CREAT | O_RDWR, 0644)) {
+      if (fd >= 0) flock(fd, LOCK_EX);
+    }
+     ~Lock() {
+      if (fd >= 0) {
+        flock(fd, LOCK_UN);
+        close(fd);
+      }
+    }
+
+    private:
+     int fd;
+  };
+
+   // 一次加锁读写 stats：更新计数，累加新存入的字节数。只有累计值超出容量时才扫描 objects 淘汰，
+   // 并用扫描得到的实际大小校正累计值；stats 中还没有字节数时也扫描一次
+   void UpdateStats(bool hit, uint64_t added) {
+    Lock lock(dir + "/lock");
+    std::ifstream in(dir + "/stats");
+    std::string name;
+    uint64_t value, bytes = 0;
+    bool known = false;
+    while (in >> name >> value) {
+      if (name == "hits") hits = value;
+      else if (name == "misses") misses = value;
+      else if (name == "bytes") bytes = value, known = true;
+    }
+    if (hit) ++hits;
+    else ++misses;
+    bytes += added;
+    if (!known || (max_bytes && bytes > max_bytes)) bytes = Evict();
+    AtomicWriteFile(dir + "/stats", "hits " + std::to_string(hits) + "\nmisses " + std::to_string(misses) +
+                                        "\nbytes " + std::to_string(bytes) + "\n");
+  }
+
+   // 按最近使用时间从旧到新删除，直到不超出容量，返回剩余的总字节数。调用方持有锁
+   uint64_t Evict() {
+    struct Entry {
+      std::filesystem::path path;
+      std::filesystem::file_time_type mtime;
+      uint64_t size;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code ec;
+    for (const auto &it : std::filesystem::directory_iterator(ObjectDir(), ec)) {
+      // 跳过其他进程尚未 rename 的临时文件
+      if (it.path().filename().string().find(".tmp.") != std::string::npos) continue;
+      Entry entry{it.path(), it.last_write_time(ec), it.file_size(ec)};
+      if (ec) continue;
+      total += entry.size;
+      entries.push_back(std::move(entry));
+    }
+    if (max_bytes == 0 || total <= max_bytes) return total;
+
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry &a, const Entry &b) { return a.mtime < b.mtime; });
+    for (const auto &entry : entries) {
+      if (total <= max_bytes) break;
+      if (std::filesystem::remove(entry.path, ec)) total -= entry.size;
+    }
+    return total;
+  }
+};
@@ -0,0 +1,128 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#include "mir.hpp"
+
+// 顺序单发射流水线的指令延迟（周期）
+struct LatencyModel {
+  int alu = 1;
+  int mul = 3;
+  int div = 20;
+  int load = 3;
+  int store = 1;
+  int branch = 1;
+
+  int Of(MOp op) const {
+    switch (op) {
+      case MOp::MUL: return mul;
+      case MOp::DIV:
+      case MOp::REM: return div;
+      case MOp::LW: return load;
+      case MOp::SW: return store;
+      case MOp::J:
+      case MOp::BEQZ:
+      case MOp::BNEZ:
+      case MOp::BEQ:
+      case MOp::BNE:
+      case MOp::BLT:
+      case MOp::BGE:
+      case MOp::CALL:
+      case MOp::RET: return branch;
+      default: return alu;
+    }
+  }
+};
+
+// -mtune=NAME 选择的延迟。generic 是默认值，rocket 和 sifive-7-series 是这两类顺序核心的近似值，
+// 除法都是迭代实现。不认识的名字返回 false
+inline bool TuneLatency(const std::string &cpu, LatencyModel &latency) {
+  if (cpu == "generic") latency = LatencyModel();
+  else if (cpu == "rocket") latency = {1, 4, 33, 3, 1, 1};
+  else if (cpu == "sifive-7-series") latency = {1, 3, 33, 3, 1, 1};
+  else return false;
+  return true;
+}
+
+struct CostStats {
+  uint64_t insts = 0;
+  uint64_t cycles = 0;
+  uint64_t spills = 0;
+  uint64_t reloads = 0;
+
+  CostStats &operator+=(const CostStats &other) {
+    insts += other.insts;
+    cycles += other.cycles;
+    spills += other.spills;
+    reloads += other.reloads;
+    return *this;
+  }
+};
+
+inline std::ostream &operator<<(std::ostream &os, const CostStats &stats) {
+  return os << "insts " << stats.insts << ", cycles " << stats.cycles << ", spills "
+            << stats.spills << ", reloads " << stats.reloads;
+}
+
+// 估计基本块的周期数：每周期最多发射一条指令，源寄存器尚未就绪时停顿，
+// 基本块的代价是最后一条指令发射后的周期数
+inline CostStats EstimateBlock(const MBlock &block, const LatencyModel &latency) {
+  CostStats stats;
+  std::unordered_map<int, uint64_t> ready;
+  uint64_t cycle = 0;
+  for (const auto &inst : block.insts) {
+    uint64_t issue = cycle;
+    for (int reg : InstUses(inst)) {
+      auto it = ready.find(reg);
+      if (it != ready.end()) issue = std::max(issue, it->second);
+    }
+    if (inst.rd != kNoReg) ready[inst.rd] = issue + latency.Of(inst.op);
+    cycle = issue + 1;
+    ++stats.insts;
+    if (inst.flags & MInst::kSpill) ++stats.spills;
+    if (inst.flags & MInst::kReload) ++stats.reloads;
+  }
+  stats.cycles = cycle;
+  return stats;
+}
+
+// 生成单个函数的报告，函数的合计写入 func_stats
+inline std::string CostReport(const MFunction &func, const LatencyModel &latency,
+                              CostStats &func_stats) {
+  std::ostringstream blocks;
+  func_stats = CostStats();
+  for (size_t b = 0; b < func.blocks.size(); ++b) {
+    CostStats stats = EstimateBlock(func.blocks[b], latency);
+    blocks << "  block " << (b == 0 ? func.name : func.blocks[b].label) << ": " << stats << "\n";
+    func_stats += stats;
+  }
+  std::ostringstream out;
+  out << "function " << func.name << ": " << func_stats << "\n" << blocks.str();
+  return out.str();
+}
+
+// 一次编译中所有函数的合计，可能被多个后端线程同时累加
+class CostSummary {
+  public:
+   void Add(const CostStats &stats) {
+    std::lock_guard<std::mutex> lock(mutex);
+    total += stats;
+    ++functions;
+  }
+
+   std::string Line() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream out;
+    out << "total: functions " << functions << ", " << total << "\n";
+    return out.str();
+  }
+
+  private:
+   std::mutex mutex;
+   CostStats total;
+   uint64_t functions = 0;
+};
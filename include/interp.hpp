@@ -0,0 +1,384 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "profile.hpp"
+
+// Koopa IR 解释器：先把 raw program 预解码成紧凑的指令数组，所有操作数都解析成
+// 帧内的槽位下标，执行时不再访问 libkoopa 的数据结构。
+// 内存按 32 位字寻址，指针就是字地址，地址 0 保留作空指针。
+class Interpreter {
+  public:
+   // profile 为 true 时统计每个基本块的执行次数，供 WriteProfile 写出
+   explicit Interpreter(const koopa_raw_program_t &program, bool profile = false) : profile(profile) {
+    mem.resize(1);
+    for (uint32_t i = 0; i < program.funcs.len; ++i) {
+      auto func = reinterpret_cast<koopa_raw_function_t>(program.funcs.buffer[i]);
+      func_ids[func] = funcs.size();
+      funcs.emplace_back();
+      funcs.back().raw = func;
+    }
+    for (uint32_t i = 0; i < program.values.len; ++i)
+      DecodeGlobal(reinterpret_cast<koopa_raw_value_t>(program.values.buffer[i]));
+    mem_top = mem.size();
+    for (auto &func : funcs) DecodeFunction(func);
+  }
+
+   // 执行 @main，返回其返回值
+   int32_t Run() {
+    for (size_t i = 0; i < funcs.size(); ++i) {
+      if (std::strcmp(funcs[i].raw->name, "@main") == 0) return Call(i, nullptr);
+    }
+    assert(false);
+    return 0;
+  }
+
+   // 按 profile.hpp 的格式写出基本块计数
+   bool WriteProfile(const std::string &path) const {
+    std::string data;
+    for (const auto &func : funcs) {
+      if (func.builtin != kNotBuiltin) continue;
+      AppendProfileWord(data, ProfileNameHash(func.raw->name + 1));
+      AppendProfileWord(data, func.raw->bbs.len);
+      for (uint32_t b = 0; b < func.raw->bbs.len; ++b) {
+        uint64_t count = block_counts[func.counts_base + b];
+        AppendProfileWord(data, static_cast<uint32_t>(std::min<uint64_t>(count, UINT32_MAX)));
+      }
+    }
+    std::ofstream out(path, std::ios::binary);
+    out << data;
+    return static_cast<bool>(out);
+  }
+
+  private:
+   enum Op : uint8_t {
+    // 二元运算，与 koopa_raw_binary_op_t 一一对应
+    OP_NE, OP_EQ, OP_GT, OP_LT, OP_GE, OP_LE, OP_ADD, OP_SUB, OP_MUL,
+    OP_DIV, OP_MOD, OP_AND, OP_OR, OP_XOR, OP_SHL, OP_SHR, OP_SAR,
+    OP_ALLOC,  // d = fp + a
+    OP_LOAD,   // d = mem[a]
+    OP_STORE,  // mem[b] = a
+    OP_GEP,    // d = a + b * c
+    OP_BR,     // a ? 跳到 b : 跳到 c
+    OP_JMP,    // 跳到 b
+    OP_CALL,   // d = funcs[a](args[b .. b + c))
+    OP_RET,    // 返回 a，a < 0 时无返回值
+    OP_COUNT,  // block_counts[a] 加一，只在剖析时插在每个基本块开头
+  };
+
+   struct Inst {
+    Op op;
+    int32_t d, a, b, c;
+  };
+
+   enum Builtin {
+    kNotBuiltin, kGetInt, kGetCh, kGetArray, kPutInt, kPutCh, kPutArray, kStartTime, kStopTime,
+  };
+
+   struct Function {
+    koopa_raw_function_t raw = nullptr;
+    Builtin builtin = kNotBuiltin;
+    std::vector<Inst> code;
+    std::vector<int32_t> args;       // CALL 指令的实参槽位
+    std::vector<int32_t> init_slots;  // 常量已经填好的初始帧
+    int32_t frame_words = 0;          // 局部 alloc 需要的内存
+    size_t counts_base = 0;           // 第一个基本块在 block_counts 中的下标
+  };
+
+   std::vector<Function> funcs;
+   std::unordered_map<koopa_raw_function_t, int32_t> func_ids;
+   std::unordered_map<koopa_raw_value_t, int32_t> global_addrs;
+   std::vector<int32_t> mem;
+   std::vector<int32_t> stack;
+   size_t mem_top = 0;
+   bool profile;
+   std::vector<uint64_t> block_counts;
+   std::chrono::steady_clock::time_point timer_start;
+
+   // 类型大小，以字为单位
+   static int32_t TypeWords(koopa_raw_type_t ty) {
+    if (ty->tag == KOOPA_RTT_ARRAY)
+      return static_cast<int32_t>(ty->data.array.len) * TypeWords(ty->data.array.base);
+    return 1;
+  }
+
+   void InitMemory(koopa_raw_value_t init, size_t addr) {
+    switch (init->kind.tag) {
+      case KOOPA_RVT_INTEGER: mem[addr] = init->kind.data.integer.value; break;
+      case KOOPA_RVT_AGGREGATE: {
+        const auto &elems = init->kind.data.aggregate.elems;
+        for (uint32_t i = 0; i < elems.len; ++i) {
+          auto elem = reinterpret_cast<koopa_raw_value_t>(elems.buffer[i]);
+          InitMemory(elem, addr);
+          addr += TypeWords(elem->ty);
+        }
+        break;
+      }
+      default:  // zeroinit/undef：内存本来就是 0
+        break;
+    }
+  }
+
+   void DecodeGlobal(koopa_raw_value_t value) {
+    assert(value->kind.tag == KOOPA_RVT_GLOBAL_ALLOC);
+    size_t addr = mem.size();
+    global_addrs[value] = addr;
+    mem.resize(addr + TypeWords(value->ty->data.pointer.base));
+    InitMemory(value->kind.data.global_alloc.init, addr);
+  }
+
+   static Builtin FindBuiltin(const std::string &name) {
+    static const std::unordered_map<std::string, Builtin> builtins = {
+        {"@getint", kGetInt},       {"@getch", kGetCh},           {"@getarray", kGetArray},
+        {"@putint", kPutInt},       {"@putch", kPutCh},           {"@putarray", kPutArray},
+        {"@starttime", kStartTime}, {"@_sysy_starttime", kStartTime},
+        {"@stoptime", kStopTime},   {"@_sysy_stoptime", kStopTime},
+    };
+    auto it = builtins.find(name);
+    return it == builtins.end() ? kNotBuiltin : it->second;
+  }
+
+   // 单个函数的解码状态
+   struct Decoder {
+    Function &func;
+    std::unordered_map<koopa_raw_value_t, int32_t> slots;
+    std::unordered_map<koopa_raw_basic_block_t, int32_t> bb_pcs;
+  };
+
+   int32_t NewSlot(Function &func, int32_t init = 0) {
+    func.init_slots.push_back(init);
+    return func.init_slots.size() - 1;
+  }
+
+   // 操作数对应的槽位；常量和全局地址放进初始帧
+   int32_t Operand(Decoder &dec, koopa_raw_value_t value) {
+    auto it = dec.slots.find(value);
+    if (it != dec.slots.end()) return it->second;
+    int32_t slot;
+    switch (value->kind.tag) {
+      case KOOPA_RVT_INTEGER: slot = NewSlot(dec.func, value->kind.data.integer.value); break;
+      case KOOPA_RVT_ZERO_INIT:
+      case KOOPA_RVT_UNDEF: slot = NewSlot(dec.func); break;
+      case KOOPA_RVT_GLOBAL_ALLOC: slot = NewSlot(dec.func, global_addrs.at(value)); break;
+      default:
+        assert(false);
+        return 0;
+    }
+    return dec.slots[value] = slot;
+  }
+
+   void DecodeFunction(Function &func) {
+    auto raw = func.raw;
+    if (raw->bbs.len == 0) {
+      func.builtin = FindBuiltin(raw->name);
+      assert(func.builtin != kNotBuiltin);
+      return;
+    }
+
+    Decoder dec{func, {}, {}};
+    func.counts_base = block_counts.size();
+    block_counts.resize(block_counts.size() + raw->bbs.len, 0);
+    // 形参占据帧的前几个槽位
+    for (uint32_t i = 0; i < raw->params.len; ++i)
+      dec.slots[reinterpret_cast<koopa_raw_value_t>(raw->params.buffer[i])] = NewSlot(func);
+    int32_t pc = 0;
+    for (uint32_t i = 0; i < raw->bbs.len; ++i) {
+      auto bb = reinterpret_cast<koopa_raw_basic_block_t>(raw->bbs.buffer[i]);
+      assert(bb->params.len == 0);
+      dec.bb_pcs[bb] = pc;
+      pc += bb->insts.len + profile;
+      for (uint32_t j = 0; j < bb->insts.len; ++j) {
+        auto inst = reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]);
+        if (inst->ty->tag != KOOPA_RTT_UNIT) dec.slots[inst] = NewSlot(func);
+      }
+    }
+
+    for (uint32_t i = 0; i < raw->bbs.len; ++i) {
+      auto bb = reinterpret_cast<koopa_raw_basic_block_t>(raw->bbs.buffer[i]);
+      if (profile) func.code.push_back({OP_COUNT, -1, static_cast<int32_t>(func.counts_base + i), 0, 0});
+      for (uint32_t j = 0; j < bb->insts.len; ++j)
+        func.code.push_back(DecodeInst(dec, reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j])));
+    }
+  }
+
+   Inst DecodeInst(Decoder &dec, koopa_raw_value_t value) {
+    const auto &kind = value->kind;
+    int32_t d = value->ty->tag == KOOPA_RTT_UNIT ? -1 : dec.slots.at(value);
+    switch (kind.tag) {
+      case KOOPA_RVT_ALLOC: {
+        int32_t offset = dec.func.frame_words;
+        dec.func.frame_words += TypeWords(value->ty->data.pointer.base);
+        return {OP_ALLOC, d, offset, 0, 0};
+      }
+      case KOOPA_RVT_LOAD:
+        return {OP_LOAD, d, Operand(dec, kind.data.load.src), 0, 0};
+      case KOOPA_RVT_STORE:
+        return {OP_STORE, -1, Operand(dec, kind.data.store.value), Operand(dec, kind.data.store.dest), 0};
+      case KOOPA_RVT_GET_PTR: {
+        auto src = kind.data.get_ptr.src;
+        return {OP_GEP, d, Operand(dec, src), Operand(dec, kind.data.get_ptr.index),
+                TypeWords(src->ty->data.pointer.base)};
+      }
+      case KOOPA_RVT_GET_ELEM_PTR: {
+        auto src = kind.data.get_elem_ptr.src;
+        return {OP_GEP, d, Operand(dec, src), Operand(dec, kind.data.get_elem_ptr.index),
+                TypeWords(src->ty->data.pointer.base->data.array.base)};
+      }
+      case KOOPA_RVT_BINARY:
+        return {static_cast<Op>(kind.data.binary.op), d, Operand(dec, kind.data.binary.lhs),
+                Operand(dec, kind.data.binary.rhs), 0};
+      case KOOPA_RVT_BRANCH:
+        assert(kind.data.branch.true_args.len == 0 && kind.data.branch.false_args.len == 0);
+        return {OP_BR, -1, Operand(dec, kind.data.branch.cond), dec.bb_pcs.at(kind.data.branch.true_bb),
+                dec.bb_pcs.at(kind.data.branch.false_bb)};
+      case KOOPA_RVT_JUMP:
+        assert(kind.data.jump.args.len == 0);
+        return {OP_JMP, -1, 0, dec.bb_pcs.at(kind.data.jump.target), 0};
+      case KOOPA_RVT_CALL: {
+        const auto &args = kind.data.call.args;
+        int32_t begin = dec.func.args.size();
+        for (uint32_t i = 0; i < args.len; ++i)
+          dec.func.args.push_back(Operand(dec, reinterpret_cast<koopa_raw_value_t>(args.buffer[i])));
+        return {OP_CALL, d, func_ids.at(kind.data.call.callee), begin, static_cast<int32_t>(args.len)};
+      }
+      case KOOPA_RVT_RETURN:
+        return {OP_RET, -1, kind.data.ret.value ? Operand(dec, kind.data.ret.value) : -1, 0, 0};
+      default:
+        assert(false);
+        return {OP_RET, -1, -1, 0, 0};
+    }
+  }
+
+   [[noreturn]] static void Trap(const char *msg) {
+    std::cout.flush();
+    std::cerr << "runtime error: " << msg << std::endl;
+    std::exit(1);
+  }
+
+   int32_t &Mem(int32_t addr) {
+    if (addr <= 0 || static_cast<size_t>(addr) >= mem_top) Trap("invalid memory access");
+    return mem[addr];
+  }
+
+   int32_t CallBuiltin(Builtin builtin, const int32_t *args) {
+    switch (builtin) {
+      case kGetInt: {
+        int x = 0;
+        if (std::scanf("%d", &x) != 1) return 0;
+        return x;
+      }
+      case kGetCh: return std::getchar();
+      case kGetArray: {
+        int n = 0;
+        if (std::scanf("%d", &n) != 1) return 0;
+        for (int i = 0; i < n; ++i) {
+          int x = 0;
+          if (std::scanf("%d", &x) != 1) break;
+          Mem(args[0] + i) = x;
+        }
+        return n;
+      }
+      case kPutInt: std::cout << args[0]; return 0;
+      case kPutCh: std::cout.put(static_cast<char>(args[0])); return 0;
+      case kPutArray:
+        std::cout << args[0] << ":";
+        for (int i = 0; i < args[0]; ++i) std::cout << " " << Mem(args[1] + i);
+        std::cout << "\n";
+        return 0;
+      case kStartTime: timer_start = std::chrono::steady_clock::now(); return 0;
+      case kStopTime: {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - timer_start);
+        std::cerr << "Timer: " << us.count() << "us" << std::endl;
+        return 0;
+      }
+      default:
+        assert(false);
+        return 0;
+    }
+  }
+
+   int32_t Call(int32_t id, const int32_t *args) {
+    const Function &func = funcs[id];
+    if (func.builtin != kNotBuiltin) return CallBuiltin(func.builtin, args);
+
+    // 新帧：槽位压在 stack 上，alloc 的内存压在 mem 上
+    size_t fp = stack.size();
+    stack.insert(stack.end(), func.init_slots.begin(), func.init_slots.end());
+    for (uint32_t i = 0; i < func.raw->params.len; ++i) stack[fp + i] = args[i];
+    size_t mem_fp = mem_top;
+    mem_top = mem_fp + func.frame_words;
+    if (mem.size() < mem_top) mem.resize(std::max(mem_top, mem.size() * 2));
+    std::fill(mem.begin() + mem_fp, mem.begin() + mem_top, 0);
+
+    int32_t *r = stack.data() + fp;
+    const Inst *code = func.code.data();
+    const Inst *pc = code;
+    int32_t result = 0;
+    for (;;) {
+      const Inst &inst = *pc++;
+      switch (inst.op) {
+        case OP_NE: r[inst.d] = r[inst.a] != r[inst.b]; break;
+        case OP_EQ: r[inst.d] = r[inst.a] == r[inst.b]; break;
+        case OP_GT: r[inst.d] = r[inst.a] > r[inst.b]; break;
+        case OP_LT: r[inst.d] = r[inst.a] < r[inst.b]; break;
+        case OP_GE: r[inst.d] = r[inst.a] >= r[inst.b]; break;
+        case OP_LE: r[inst.d] = r[inst.a] <= r[inst.b]; break;
+        case OP_ADD: r[inst.d] = static_cast<uint32_t>(r[inst.a]) + static_cast<uint32_t>(r[inst.b]); break;
+        case OP_SUB: r[inst.d] = static_cast<uint32_t>(r[inst.a]) - static_cast<uint32_t>(r[inst.b]); break;
+        case OP_MUL: r[inst.d] = static_cast<uint32_t>(r[inst.a]) * static_cast<uint32_t>(r[inst.b]); break;
+        case OP_DIV:
+          if (r[inst.b] == 0) Trap("division by zero");
+          r[inst.d] = r[inst.b] == -1 ? -static_cast<uint32_t>(r[inst.a]) : r[inst.a] / r[inst.b];
+          break;
+        case OP_MOD:
+          if (r[inst.b] == 0) Trap("division by zero");
+          r[inst.d] = r[inst.b] == -1 ? 0 : r[inst.a] % r[inst.b];
+          break;
+        case OP_AND: r[inst.d] = r[inst.a] & r[inst.b]; break;
+        case OP_OR: r[inst.d] = r[inst.a] | r[inst.b]; break;
+        case OP_XOR: r[inst.d] = r[inst.a] ^ r[inst.b]; break;
+        case OP_SHL: r[inst.d] = static_cast<uint32_t>(r[inst.a]) << (r[inst.b] & 31); break;
+        case OP_SHR: r[inst.d] = static_cast<uint32_t>(r[inst.a]) >> (r[inst.b] & 31); break;
+        case OP_SAR: r[inst.d] = r[inst.a] >> (r[inst.b] & 31); break;
+        case OP_ALLOC: r[inst.d] = static_cast<int32_t>(mem_fp) + inst.a; break;
+        case OP_LOAD: r[inst.d] = Mem(r[inst.a]); break;
+        case OP_STORE: Mem(r[inst.b]) = r[inst.a]; break;
+        case OP_GEP: r[inst.d] = r[inst.a] + r[inst.b] * inst.c; break;
+        case OP_BR: pc = code + (r[inst.a] ? inst.b : inst.c); break;
+        case OP_JMP: pc = code + inst.b; break;
+        case OP_CALL: {
+          int32_t argv[8];
+          std::vector<int32_t> more;
+          int32_t *call_args = argv;
+          if (inst.c > 8) {
+            more.resize(inst.c);
+            call_args = more.data();
+          }
+          for (int32_t i = 0; i < inst.c; ++i) call_args[i] = r[func.args[inst.b + i]];
+          int32_t ret = Call(inst.a, call_args);
+          // 被调函数可能让 stack 重新分配
+          r = stack.data() + fp;
+          if (inst.d >= 0) r[inst.d] = ret;
+          break;
+        }
+        case OP_COUNT: ++block_counts[inst.a]; break;
+        case OP_RET:
+          result = inst.a >= 0 ? r[inst.a] : 0;
+          stack.resize(fp);
+          mem_top = mem_fp;
+          return result;
+      }
+    }
+  }
+};
@@ -0,0 +1,530 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Koopa IR 的二进制格式，用于缓存和阶段间传递：
+//   "KPIR" u8 版本号
+//   类型表  : n, {tag, ...}，基类型总在引用者之前
+//   字符串表: n, {len, bytes, '\0'}，加载时名字直接指向映射的内存
+//   计数    : nvalues, nbbs, nfuncs
+//   值表    : {tag, type, name, 操作数...}
+//   程序    : nglobals, {value}
+//   函数表  : {type, name, nparams, {value}, nbbs, {bb}}
+//   基本块表: {name, nparams, {value}, ninsts, {value}}
+// 整数一律为 LEB128 varint（有符号数先 zigzag），类型/名字/值/基本块/函数
+// 都以表下标引用，名字下标 0 表示没有名字。
+static const char kKoopaBinMagic[4] = {'K', 'P', 'I', 'R'};
+static const uint8_t kKoopaBinVersion = 1;
+
+// 把 raw program 序列化为二进制格式
+class KoopaBinaryWriter {
+  public:
+   explicit KoopaBinaryWriter(const koopa_raw_program_t &program) : program(program) {}
+
+   void Write(std::ostream &os) {
+    Collect();
+    std::string out(kKoopaBinMagic, sizeof(kKoopaBinMagic));
+    out.push_back(static_cast<char>(kKoopaBinVersion));
+
+    PutVarint(out, types.size());
+    out += type_bytes;
+    PutVarint(out, strings.size());
+    for (const char *str : strings) {
+      size_t len = std::strlen(str);
+      PutVarint(out, len);
+      out.append(str, len + 1);
+    }
+
+    PutVarint(out, values.size());
+    PutVarint(out, bbs.size());
+    PutVarint(out, funcs.size());
+    for (auto value : values) WriteValue(out, value);
+
+    PutVarint(out, program.values.len);
+    for (uint32_t i = 0; i < program.values.len; ++i)
+      PutVarint(out, value_ids[program.values.buffer[i]]);
+
+    for (auto func : funcs) {
+      PutVarint(out, type_ids[func->ty]);
+      PutVarint(out, StringId(func->name));
+      WriteSlice(out, func->params, value_ids);
+      WriteSlice(out, func->bbs, bb_ids);
+    }
+    for (auto bb : bbs) {
+      PutVarint(out, StringId(bb->name));
+      WriteSlice(out, bb->params, value_ids);
+      WriteSlice(out, bb->insts, value_ids);
+    }
+    os.write(out.data(), out.size());
+  }
+
+  private:
+   const koopa_raw_program_t &program;
+   std::vector<koopa_raw_type_t> types;
+   std::string type_bytes;
+   std::vector<const char *> strings;
+   std::vector<koopa_raw_value_t> values;
+   std::vector<koopa_raw_basic_block_t> bbs;
+   std::vector<koopa_raw_function_t> funcs;
+   std::unordered_map<const void *, uint32_t> type_ids, value_ids, bb_ids, func_ids;
+   std::unordered_map<std::string, uint32_t> string_ids, type_keys;
+
+   static void PutVarint(std::string &out, uint64_t x) {
+    while (x >= 0x80) {
+      out.push_back(static_cast<char>(x | 0x80));
+      x >>= 7;
+    }
+    out.push_back(static_cast<char>(x));
+  }
+
+   static void PutSigned(std::string &out, int64_t x) {
+    PutVarint(out, (static_cast<uint64_t>(x) << 1) ^ static_cast<uint64_t>(x >> 63));
+  }
+
+   uint32_t StringId(const char *str) {
+    if (!str) return 0;
+    auto it = string_ids.find(str);
+    if (it != string_ids.end()) return it->second;
+    strings.push_back(str);
+    return string_ids[str] = strings.size();
+  }
+
+   // 类型按结构去重，编码本身就是去重的键
+   uint32_t AddType(koopa_raw_type_t ty) {
+    auto it = type_ids.find(ty);
+    if (it != type_ids.end()) return it->second;
+    std::string key;
+    PutVarint(key, ty->tag);
+    switch (ty->tag) {
+      case KOOPA_RTT_ARRAY:
+        PutVarint(key, AddType(ty->data.array.base));
+        PutVarint(key, ty->data.array.len);
+        break;
+      case KOOPA_RTT_POINTER:
+        PutVarint(key, AddType(ty->data.pointer.base));
+        break;
+      case KOOPA_RTT_FUNCTION: {
+        const auto &params = ty->data.function.params;
+        std::vector<uint32_t> ids;
+        for (uint32_t i = 0; i < params.len; ++i)
+          ids.push_back(AddType(reinterpret_cast<koopa_raw_type_t>(params.buffer[i])));
+        uint32_t ret = AddType(ty->data.function.ret);
+        PutVarint(key, ids.size());
+        for (auto id : ids) PutVarint(key, id);
+        PutVarint(key, ret);
+        break;
+      }
+      default:
+        break;
+    }
+    auto found = type_keys.find(key);
+    if (found != type_keys.end()) return type_ids[ty] = found->second;
+    type_bytes += key;
+    types.push_back(ty);
+    type_keys[key] = types.size() - 1;
+    return type_ids[ty] = types.size() - 1;
+  }
+
+   void AddValue(koopa_raw_value_t value) {
+    if (!value || value_ids.count(value)) return;
+    value_ids[value] = values.size();
+    values.push_back(value);
+    AddType(value->ty);
+    StringId(value->name);
+    const auto &kind = value->kind;
+    switch (kind.tag) {
+      case KOOPA_RVT_AGGREGATE:
+        for (uint32_t i = 0; i < kind.data.aggregate.elems.len; ++i)
+          AddValue(reinterpret_cast<koopa_raw_value_t>(kind.data.aggregate.elems.buffer[i]));
+        break;
+      case KOOPA_RVT_GLOBAL_ALLOC: AddValue(kind.data.global_alloc.init); break;
+      case KOOPA_RVT_LOAD: AddValue(kind.data.load.src); break;
+      case KOOPA_RVT_STORE:
+        AddValue(kind.data.store.value);
+        AddValue(kind.data.store.dest);
+        break;
+      case KOOPA_RVT_GET_PTR:
+        AddValue(kind.data.get_ptr.src);
+        AddValue(kind.data.get_ptr.index);
+        break;
+      case KOOPA_RVT_GET_ELEM_PTR:
+        AddValue(kind.data.get_elem_ptr.src);
+        AddValue(kind.data.get_elem_ptr.index);
+        break;
+      case KOOPA_RVT_BINARY:
+        AddValue(kind.data.binary.lhs);
+        AddValue(kind.data.binary.rhs);
+        break;
+      case KOOPA_RVT_BRANCH:
+        AddValue(kind.data.branch.cond);
+        AddValues(kind.data.branch.true_args);
+        AddValues(kind.data.branch.false_args);
+        break;
+      case KOOPA_RVT_JUMP: AddValues(kind.data.jump.args); break;
+      case KOOPA_RVT_CALL: AddValues(kind.data.call.args); break;
+      case KOOPA_RVT_RETURN: AddValue(kind.data.ret.value); break;
+      default:
+        break;
+    }
+  }
+
+   void AddValues(const koopa_raw_slice_t &slice) {
+    for (uint32_t i = 0; i < slice.len; ++i)
+      AddValue(reinterpret_cast<koopa_raw_value_t>(slice.buffer[i]));
+  }
+
+   // 先给所有对象编号，写出时操作数才能用下标引用
+   void Collect() {
+    AddValues(program.values);
+    for (uint32_t i = 0; i < program.funcs.len; ++i) {
+      auto func = reinterpret_cast<koopa_raw_function_t>(program.funcs.buffer[i]);
+      func_ids[func] = funcs.size();
+      funcs.push_back(func);
+      AddType(func->ty);
+      StringId(func->name);
+    }
+    for (auto func : funcs) {
+      AddValues(func->params);
+      for (uint32_t i = 0; i < func->bbs.len; ++i) {
+        auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        bb_ids[bb] = bbs.size();
+        bbs.push_back(bb);
+        StringId(bb->name);
+        AddValues(bb->params);
+        AddValues(bb->insts);
+      }
+    }
+  }
+
+   void WriteSlice(std::string &out, const koopa_raw_slice_t &slice,
+                   std::unordered_map<const void *, uint32_t> &ids) {
+    PutVarint(out, slice.len);
+    for (uint32_t i = 0; i < slice.len; ++i) PutVarint(out, ids[slice.buffer[i]]);
+  }
+
+   void WriteValue(std::string &out, koopa_raw_value_t value) {
+    const auto &kind = value->kind;
+    PutVarint(out, kind.tag);
+    PutVarint(out, type_ids[value->ty]);
+    PutVarint(out, StringId(value->name));
+    switch (kind.tag) {
+      case KOOPA_RVT_INTEGER: PutSigned(out, kind.data.integer.value); break;
+      case KOOPA_RVT_AGGREGATE: WriteSlice(out, kind.data.aggregate.elems, value_ids); break;
+      case KOOPA_RVT_FUNC_ARG_REF: PutVarint(out, kind.data.func_arg_ref.index); break;
+      case KOOPA_RVT_BLOCK_ARG_REF: PutVarint(out, kind.data.block_arg_ref.index); break;
+      case KOOPA_RVT_GLOBAL_ALLOC: PutVarint(out, value_ids[kind.data.global_alloc.init]); break;
+      case KOOPA_RVT_LOAD: PutVarint(out, value_ids[kind.data.load.src]); break;
+      case KOOPA_RVT_STORE:
+        PutVarint(out, value_ids[kind.data.store.value]);
+        PutVarint(out, value_ids[kind.data.store.dest]);
+        break;
+      case KOOPA_RVT_GET_PTR:
+        PutVarint(out, value_ids[kind.data.get_ptr.src]);
+        PutVarint(out, value_ids[kind.data.get_ptr.index]);
+        break;
+      case KOOPA_RVT_GET_ELEM_PTR:
+        PutVarint(out, value_ids[kind.data.get_elem_ptr.src]);
+        PutVarint(out, value_ids[kind.data.get_elem_ptr.index]);
+        break;
+      case KOOPA_RVT_BINARY:
+        PutVarint(out, kind.data.binary.op);
+        PutVarint(out, value_ids[kind.data.binary.lhs]);
+        PutVarint(out, value_ids[kind.data.binary.rhs]);
+        break;
+      case KOOPA_RVT_BRANCH:
+        PutVarint(out, value_ids[kind.data.branch.cond]);
+        PutVarint(out, bb_ids[kind.data.branch.true_bb]);
+        PutVarint(out, bb_ids[kind.data.branch.false_bb]);
+        WriteSlice(out, kind.data.branch.true_args, value_ids);
+        WriteSlice(out, kind.data.branch.false_args, value_ids);
+        break;
+      case KOOPA_RVT_JUMP:
+        PutVarint(out, bb_ids[kind.data.jump.target]);
+        WriteSlice(out, kind.data.jump.args, value_ids);
+        break;
+      case KOOPA_RVT_CALL:
+        PutVarint(out, func_ids[kind.data.call.callee]);
+        WriteSlice(out, kind.data.call.args, value_ids);
+        break;
+      case KOOPA_RVT_RETURN:
+        PutVarint(out, kind.data.ret.value ? value_ids[kind.data.ret.value] + 1 : 0);
+        break;
+      default:
+        break;
+    }
+  }
+};
+
+inline void WriteKoopaBinary(const koopa_raw_program_t &program, std::ostream &os) {
+  KoopaBinaryWriter(program).Write(os);
+}
+
+// 从二进制格式重建 raw program。文件通过 mmap 载入，名字直接引用映射内存，
+// 所以对象存活期间 program 一直有效。
+class KoopaBinaryProgram {
+  public:
+   koopa_raw_program_t program;
+
+   KoopaBinaryProgram() = default;
+   KoopaBinaryProgram(const KoopaBinaryProgram &) = delete;
+   KoopaBinaryProgram &operator=(const KoopaBinaryProgram &) = delete;
+
+   ~KoopaBinaryProgram() {
+    if (map) munmap(map, map_size);
+  }
+
+   bool LoadFile(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      close(fd);
+      return false;
+    }
+    map_size = st.st_size;
+    map = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+      map = nullptr;
+      return false;
+    }
+    return Load(static_cast<const uint8_t *>(map), map_size);
+  }
+
+   // data 必须在对象存活期间保持有效
+   bool Load(const uint8_t *data, size_t size) {
+    cur = data;
+    end = data + size;
+    if (size < 5 || std::memcmp(data, kKoopaBinMagic, 4) != 0 || data[4] != kKoopaBinVersion)
+      return false;
+    cur += 5;
+
+    types.resize(GetCount());
+    for (auto &ty : types) ReadType(ty);
+    names.resize(GetCount());
+    for (auto &name : names) {
+      size_t len = GetCount();
+      if (!Need(len + 1) || cur[len] != '\0') return false;
+      name = reinterpret_cast<const char *>(cur);
+      cur += len + 1;
+    }
+
+    values.resize(GetCount());
+    bbs.resize(GetCount());
+    funcs.resize(GetCount());
+    value_users.resize(values.size());
+    bb_users.resize(bbs.size());
+    for (size_t i = 0; i < values.size() && !bad; ++i) ReadValue(values[i]);
+
+    program.values = ReadSlice(KOOPA_RSIK_VALUE, nullptr);
+    auto &func_items = slices.emplace_back();
+    for (auto &func : funcs) {
+      func_items.push_back(&func);
+      func.ty = Type(GetVarint());
+      func.name = Name();
+      func.params = ReadSlice(KOOPA_RSIK_VALUE, nullptr);
+      func.bbs = ReadSlice(KOOPA_RSIK_BASIC_BLOCK, nullptr);
+    }
+    program.funcs = SliceOf(func_items, KOOPA_RSIK_FUNCTION);
+    for (auto &bb : bbs) {
+      bb.name = Name();
+      bb.params = ReadSlice(KOOPA_RSIK_VALUE, nullptr);
+      bb.insts = ReadSlice(KOOPA_RSIK_VALUE, nullptr);
+    }
+
+    // used_by 不写入文件，按操作数关系重建
+    for (size_t i = 0; i < values.size(); ++i)
+      values[i].used_by = SliceOf(value_users[i], KOOPA_RSIK_VALUE);
+    for (size_t i = 0; i < bbs.size(); ++i) bbs[i].used_by = SliceOf(bb_users[i], KOOPA_RSIK_VALUE);
+    return !bad;
+  }
+
+  private:
+   void *map = nullptr;
+   size_t map_size = 0;
+   const uint8_t *cur = nullptr;
+   const uint8_t *end = nullptr;
+   bool bad = false;
+
+   std::vector<koopa_raw_type_kind_t> types;
+   std::vector<const char *> names;
+   std::vector<koopa_raw_value_data_t> values;
+   std::vector<koopa_raw_basic_block_data_t> bbs;
+   std::vector<koopa_raw_function_data_t> funcs;
+   std::vector<std::vector<const void *>> value_users, bb_users;
+   std::deque<std::vector<const void *>> slices;
+
+   bool Need(size_t n) {
+    if (static_cast<size_t>(end - cur) < n) bad = true;
+    return !bad;
+  }
+
+   uint64_t GetVarint() {
+    uint64_t x = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (!Need(1)) return 0;
+      uint8_t byte = *cur++;
+      x |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) return x;
+    }
+    bad = true;
+    return 0;
+  }
+
+   // 读取一个表长度，不可能超过剩余字节数
+   size_t GetCount() {
+    uint64_t n = GetVarint();
+    if (n > static_cast<uint64_t>(end - cur)) bad = true;
+    return bad ? 0 : n;
+  }
+
+   int32_t GetSigned() {
+    uint64_t x = GetVarint();
+    return static_cast<int32_t>((x >> 1) ^ (~(x & 1) + 1));
+  }
+
+   template <typename T>
+   T *Index(std::vector<T> &table, uint64_t id) {
+    if (id >= table.size()) {
+      bad = true;
+      return nullptr;
+    }
+    return &table[id];
+  }
+
+   koopa_raw_type_t Type(uint64_t id) { return Index(types, id); }
+
+   const char *Name() {
+    uint64_t id = GetVarint();
+    if (id == 0) return nullptr;
+    auto name = Index(names, id - 1);
+    return name ? *name : nullptr;
+  }
+
+   koopa_raw_value_t Value(const void *user) {
+    uint64_t id = GetVarint();
+    auto value = Index(values, id);
+    if (value && user) value_users[id].push_back(user);
+    return value;
+  }
+
+   koopa_raw_basic_block_t BasicBlock(const void *user) {
+    uint64_t id = GetVarint();
+    auto bb = Index(bbs, id);
+    if (bb && user) bb_users[id].push_back(user);
+    return bb;
+  }
+
+   static koopa_raw_slice_t SliceOf(std::vector<const void *> &items,
+                                    koopa_raw_slice_item_kind_t kind) {
+    return {items.empty() ? nullptr : items.data(), static_cast<uint32_t>(items.size()), kind};
+  }
+
+   koopa_raw_slice_t ReadSlice(koopa_raw_slice_item_kind_t kind, const void *user) {
+    size_t n = GetCount();
+    auto &items = slices.emplace_back();
+    items.reserve(n);
+    for (size_t i = 0; i < n && !bad; ++i) {
+      switch (kind) {
+        case KOOPA_RSIK_TYPE: items.push_back(Type(GetVarint())); break;
+        case KOOPA_RSIK_VALUE: items.push_back(Value(user)); break;
+        case KOOPA_RSIK_BASIC_BLOCK: items.push_back(BasicBlock(user)); break;
+        default: bad = true; break;
+      }
+    }
+    return SliceOf(items, kind);
+  }
+
+   void ReadType(koopa_raw_type_kind_t &ty) {
+    ty.tag = static_cast<koopa_raw_type_tag_t>(GetVarint());
+    switch (ty.tag) {
+      case KOOPA_RTT_ARRAY:
+        ty.data.array.base = Type(GetVarint());
+        ty.data.array.len = GetVarint();
+        break;
+      case KOOPA_RTT_POINTER: ty.data.pointer.base = Type(GetVarint()); break;
+      case KOOPA_RTT_FUNCTION:
+        ty.data.function.params = ReadSlice(KOOPA_RSIK_TYPE, nullptr);
+        ty.data.function.ret = Type(GetVarint());
+        break;
+      default:
+        break;
+    }
+  }
+
+   void ReadValue(koopa_raw_value_data_t &value) {
+    auto &kind = value.kind;
+    kind.tag = static_cast<koopa_raw_value_tag_t>(GetVarint());
+    value.ty = Type(GetVarint());
+    value.name = Name();
+    const void *self = &value;
+    switch (kind.tag) {
+      case KOOPA_RVT_INTEGER: kind.data.integer.value = GetSigned(); break;
+      case KOOPA_RVT_AGGREGATE:
+        kind.data.aggregate.elems = ReadSlice(KOOPA_RSIK_VALUE, self);
+        break;
+      case KOOPA_RVT_FUNC_ARG_REF: kind.data.func_arg_ref.index = GetVarint(); break;
+      case KOOPA_RVT_BLOCK_ARG_REF: kind.data.block_arg_ref.index = GetVarint(); break;
+      case KOOPA_RVT_GLOBAL_ALLOC: kind.data.global_alloc.init = Value(self); break;
+      case KOOPA_RVT_LOAD: kind.data.load.src = Value(self); break;
+      case KOOPA_RVT_STORE:
+        kind.data.store.value = Value(self);
+        kind.data.store.dest = Value(self);
+        break;
+      case KOOPA_RVT_GET_PTR:
+        kind.data.get_ptr.src = Value(self);
+        kind.data.get_ptr.index = Value(self);
+        break;
+      case KOOPA_RVT_GET_ELEM_PTR:
+        kind.data.get_elem_ptr.src = Value(self);
+        kind.data.get_elem_ptr.index = Value(self);
+        break;
+      case KOOPA_RVT_BINARY:
+        kind.data.binary.op = static_cast<koopa_raw_binary_op_t>(GetVarint());
+        kind.data.binary.lhs = Value(self);
+        kind.data.binary.rhs = Value(self);
+        break;
+      case KOOPA_RVT_BRANCH:
+        kind.data.branch.cond = Value(self);
+        kind.data.branch.true_bb = BasicBlock(self);
+        kind.data.branch.false_bb = BasicBlock(self);
+        kind.data.branch.true_args = ReadSlice(KOOPA_RSIK_VALUE, self);
+        kind.data.branch.false_args = ReadSlice(KOOPA_RSIK_VALUE, self);
+        break;
+      case KOOPA_RVT_JUMP:
+        kind.data.jump.target = BasicBlock(self);
+        kind.data.jump.args = ReadSlice(KOOPA_RSIK_VALUE, self);
+        break;
+      case KOOPA_RVT_CALL:
+        kind.data.call.callee = Index(funcs, GetVarint());
+        kind.data.call.args = ReadSlice(KOOPA_RSIK_VALUE, self);
+        break;
+      case KOOPA_RVT_RETURN: {
+        uint64_t id = GetVarint();
+        kind.data.ret.value = nullptr;
+        if (id != 0) {
+          kind.data.ret.value = Index(values, id - 1);
+          if (kind.data.ret.value) value_users[id - 1].push_back(self);
+        }
+        break;
+      }
+      case KOOPA_RVT_ZERO_INIT:
+      case KOOPA_RVT_UNDEF:
+      case KOOPA_RVT_ALLOC:
+        break;
+      default:
+        bad = true;
+        break;
+    }
+  }
+};
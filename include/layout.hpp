@@ -0,0 +1,121 @@
+#pragma once
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "mir.hpp"
+
+inline std::vector<std::vector<size_t>> BlockSuccessors(const MFunction &func) {
+  // 标签在函数内不会改动，用 string_view 作键，不复制标签；预留容量避免逐次扩容重哈希
+  std::unordered_map<std::string_view, size_t> index;
+  index.reserve(func.blocks.size());
+  for (size_t i = 0; i < func.blocks.size(); ++i) index[func.blocks[i].label] = i;
+  std::vector<std::vector<size_t>> succs(func.blocks.size());
+  for (size_t b = 0; b < func.blocks.size(); ++b) {
+    for (const auto &inst : func.blocks[b].insts) {
+      if (IsBranch(inst.op)) succs[b].push_back(index.at(inst.sym));
+    }
+  }
+  return succs;
+}
+
+// 没有剖析数据时静态估计执行次数：每层循环按 8 次计。跳回到前面的块视为回边，
+// 回边的自然循环是能不经过循环头到达回边起点的所有块；从循环里 break 或 return 出去的块
+// 到不了回边，不算在循环里，排布时会被挪到热路径之外
+inline void EstimateBlockCounts(MFunction &func) {
+  size_t n = func.blocks.size();
+  auto succs = BlockSuccessors(func);
+  std::vector<std::vector<size_t>> preds(n);
+  for (size_t b = 0; b < n; ++b) {
+    for (size_t s : succs[b]) preds[s].push_back(b);
+  }
+  std::vector<int> depth(n, 0);
+  std::vector<bool> in_loop(n);
+  std::vector<size_t> body;
+  for (size_t latch = 0; latch < n; ++latch) {
+    for (size_t header : succs[latch]) {
+      if (header > latch) continue;
+      // 只访问和清除循环体中的块，花费与循环体大小成正比
+      body = {header};
+      in_loop[header] = true;
+      std::vector<size_t> stack = {latch};
+      while (!stack.empty()) {
+        size_t b = stack.back();
+        stack.pop_back();
+        if (in_loop[b]) continue;
+        in_loop[b] = true;
+        body.push_back(b);
+        for (size_t p : preds[b]) stack.push_back(p);
+      }
+      for (size_t b : body) {
+        ++depth[b];
+        in_loop[b] = false;
+      }
+    }
+  }
+  for (size_t b = 0; b < n; ++b) func.blocks[b].count = uint64_t(1) << (3 * std::min(depth[b], 20));
+}
+
+// 基本块排布。入口块总在最前；之后每次优先放当前块执行次数最多的后继，让热路径上的
+// 跳转变成直接落入下一块；当前块的后继都已放好时，从剩下的块里取执行次数最多的开始新链。
+// 次数相同时保持原来的顺序。
+inline void LayoutBlocks(MFunction &func) {
+  size_t n = func.blocks.size();
+  if (n <= 2) return;
+  auto succs = BlockSuccessors(func);
+
+  std::vector<bool> placed(n, false);
+  // 开始新链时的候选按执行次数从多到少排好，次数相同时保持原来的顺序。已经放好的块只会
+  // 在表头被跳过，游标单调前进，不必每次都扫描所有块，也不用逐次维护堆。
+  // 排序的是紧凑的（次数，块号）对，比较时不必随机访问各个块
+  std::vector<std::pair<uint64_t, size_t>> heads(n - 1);
+  for (size_t i = 1; i < n; ++i) heads[i - 1] = {func.blocks[i].count, i};
+  std::sort(heads.begin(), heads.end(), [](const auto &a, const auto &b) {
+    return a.first != b.first ? a.first > b.first : a.second < b.second;
+  });
+  size_t next_head = 0;
+  std::vector<size_t> order = {0};
+  placed[0] = true;
+  while (order.size() < n) {
+    size_t best = n;
+    auto better = [&](size_t i) {
+      return best == n || func.blocks[i].count > func.blocks[best].count ||
+             (func.blocks[i].count == func.blocks[best].count && i < best);
+    };
+    for (size_t succ : succs[order.back()]) {
+      if (!placed[succ] && better(succ)) best = succ;
+    }
+    if (best == n) {
+      while (placed[heads[next_head].second]) ++next_head;
+      best = heads[next_head].second;
+    }
+    placed[best] = true;
+    order.push_back(best);
+  }
+
+  std::vector<MBlock> blocks;
+  for (size_t i : order) blocks.push_back(std::move(func.blocks[i]));
+  func.blocks = std::move(blocks);
+}
+
+// 去掉跳到下一块的 j；条件跳转的目标是下一块时取反条件，省掉后面的 j
+inline void ElideFallthroughJumps(MFunction &func) {
+  for (size_t b = 0; b + 1 < func.blocks.size(); ++b) {
+    auto &insts = func.blocks[b].insts;
+    const std::string &next = func.blocks[b + 1].label;
+    if (insts.empty() || insts.back().op != MOp::J) continue;
+    if (insts.back().sym == next) {
+      insts.pop_back();
+      continue;
+    }
+    if (insts.size() < 2) continue;
+    MInst &cond = insts[insts.size() - 2];
+    if (IsCondBranch(cond.op) && cond.sym == next) {
+      cond.op = InvertBranch(cond.op);
+      cond.sym = insts.back().sym;
+      insts.pop_back();
+    }
+  }
+}
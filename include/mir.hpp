@@ -0,0 +1,279 @@
+#pragma once
+#include <cassert>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// RISC-V 机器指令。指令选择先生成使用虚拟寄存器的 MFunction，
+// 之后寄存器分配、栈帧布局、代价估计和输出都在这一层完成。
+
+// 物理寄存器按 x0-x31 编号，虚拟寄存器从 kVRegBase 开始
+enum Reg : int {
+  kNoReg = -1,
+  ZERO = 0, RA = 1, SP = 2, GP = 3, TP = 4, T0 = 5, T1 = 6, T2 = 7,
+  S0 = 8, S1 = 9, A0 = 10, A1, A2, A3, A4, A5, A6, A7,
+  S2 = 18, S3, S4, S5, S6, S7, S8, S9, S10, S11,
+  T3 = 28, T4, T5, T6,
+};
+static const int kVRegBase = 64;
+
+inline bool IsVReg(int reg) { return reg >= kVRegBase; }
+
+// 调用会改写的寄存器
+inline bool IsCallerSaved(int reg) {
+  return reg == RA || (reg >= T0 && reg <= T2) || (reg >= A0 && reg <= A7) || (reg >= T3 && reg <= T6);
+}
+
+inline bool IsCalleeSaved(int reg) { return reg == S0 || reg == S1 || (reg >= S2 && reg <= S11); }
+
+inline const char *RegName(int reg) {
+  static const char *const names[32] = {
+      "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2", "s0", "s1", "a0",
+      "a1",   "a2", "a3", "a4", "a5", "a6", "a7", "s2", "s3", "s4", "s5",
+      "s6",   "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6",
+  };
+  assert(reg >= 0 && reg < 32);
+  return names[reg];
+}
+
+enum class MOp {
+  LI, LA, MV,
+  ADD, ADDI, SUB, MUL, DIV, REM, AND, OR, XOR, XORI, SLL, SLLI, SRL, SRA, SLT, SEQZ, SNEZ,
+  LW, SW,
+  J, BEQZ, BNEZ, BEQ, BNE, BLT, BGE,
+  CALL, RET,
+};
+
+// call 的 imm 是放在 a0-a7 中的实参个数，其余实参在栈顶
+struct MInst {
+  // kSpill/kReload：指令由寄存器分配插入的溢出存取；
+  // kIncoming：imm 相对调用者栈帧中传入的参数，栈帧布局后加上栈帧大小
+  enum Flag : uint8_t { kNone = 0, kSpill = 1, kReload = 2, kIncoming = 4 };
+
+  MOp op;
+  int rd = kNoReg, rs1 = kNoReg, rs2 = kNoReg;
+  int32_t imm = 0;
+  std::string sym;  // 跳转目标或全局符号
+  int frame = -1;   // rs1 为 sp 时，imm 相对的栈帧对象；栈帧布局后换算成偏移
+  uint8_t flags = kNone;
+};
+
+struct MBlock {
+  std::string label;
+  std::vector<MInst> insts;
+  uint64_t count = 0;  // 剖析得到的执行次数，没有剖析数据时为 0
+};
+
+struct MFunction {
+  std::string name;
+  std::vector<MBlock> blocks;
+  std::vector<int32_t> frame_objects;  // 每个栈帧对象的字节数
+  int32_t outgoing_size = 0;            // 栈顶传给被调函数的实参区的字节数
+  std::vector<int> saved_regs;          // 用到的被调者保存寄存器，序言保存、尾声恢复
+  int next_vreg = kVRegBase;
+  int frame_size = 0;
+
+  int NewVReg() { return next_vreg++; }
+
+  int NewFrameObject(int32_t size) {
+    frame_objects.push_back(size);
+    return frame_objects.size() - 1;
+  }
+};
+
+inline bool IsCondBranch(MOp op) {
+  return op == MOp::BEQZ || op == MOp::BNEZ || op == MOp::BEQ || op == MOp::BNE ||
+         op == MOp::BLT || op == MOp::BGE;
+}
+
+inline bool IsBranch(MOp op) { return op == MOp::J || IsCondBranch(op); }
+
+// 条件相反的分支
+inline MOp InvertBranch(MOp op) {
+  switch (op) {
+    case MOp::BEQZ: return MOp::BNEZ;
+    case MOp::BNEZ: return MOp::BEQZ;
+    case MOp::BEQ: return MOp::BNE;
+    case MOp::BNE: return MOp::BEQ;
+    case MOp::BLT: return MOp::BGE;
+    case MOp::BGE: return MOp::BLT;
+    default: assert(false); return op;
+  }
+}
+
+inline bool IsTerminator(MOp op) { return IsBranch(op) || op == MOp::RET; }
+
+inline bool HasCall(const MFunction &func) {
+  for (const auto &block : func.blocks) {
+    for (const auto &inst : block.insts) {
+      if (inst.op == MOp::CALL) return true;
+    }
+  }
+  return false;
+}
+
+inline bool IsStore(MOp op) { return op == MOp::SW; }
+
+// 指令读取的寄存器（不含 ret 对 a0 的隐式读取）
+inline std::vector<int> InstUses(const MInst &inst) {
+  std::vector<int> uses;
+  if (inst.rs1 != kNoReg) uses.push_back(inst.rs1);
+  if (inst.rs2 != kNoReg && inst.rs2 != inst.rs1) uses.push_back(inst.rs2);
+  return uses;
+}
+
+inline int InstDef(const MInst &inst) { return inst.rd; }
+
+inline bool FitsImm12(int64_t imm) { return imm >= -2048 && imm <= 2047; }
+
+// 栈帧布局：栈顶是传给被调函数的实参，之上依次是栈帧对象和保存的寄存器。
+// 为栈帧对象分配偏移，插入保存 ra 和被调者保存寄存器的序言和尾声，并把超出 12 位立即数范围的
+// 偏移改写为经 t6 计算地址
+inline void LayoutFrame(MFunction &func, bool saves_ra) {
+  std::vector<int32_t> offsets;
+  int32_t offset = func.outgoing_size;
+  for (int32_t size : func.frame_objects) {
+    offsets.push_back(offset);
+    offset += (size + 3) & ~3;
+  }
+  std::vector<std::pair<int, int32_t>> saves;
+  if (saves_ra) saves.push_back({RA, 0});
+  for (int reg : func.saved_regs) saves.push_back({reg, 0});
+  for (auto &save : saves) {
+    save.second = offset;
+    offset += 4;
+  }
+  func.frame_size = (offset + 15) & ~15;
+  int32_t frame_size = func.frame_size;
+
+  auto adjust_sp = [](std::vector<MInst> &out, int32_t delta) {
+    if (delta == 0) return;
+    if (FitsImm12(delta)) {
+      out.push_back({MOp::ADDI, SP, SP, kNoReg, delta});
+    } else {
+      out.push_back({MOp::LI, T6, kNoReg, kNoReg, delta});
+      out.push_back({MOp::ADD, SP, SP, T6});
+    }
+  };
+  // sp 相对的存取，偏移过大时先算出地址
+  auto mem = [](std::vector<MInst> &out, MInst inst) {
+    if (inst.rs1 != SP || FitsImm12(inst.imm)) {
+      out.push_back(std::move(inst));
+      return;
+    }
+    out.push_back({MOp::LI, T6, kNoReg, kNoReg, inst.imm});
+    out.push_back({MOp::ADD, T6, SP, T6});
+    inst.rs1 = T6;
+    inst.imm = 0;
+    out.push_back(std::move(inst));
+  };
+
+  for (size_t b = 0; b < func.blocks.size(); ++b) {
+    std::vector<MInst> out;
+    if (b == 0) {
+      adjust_sp(out, -frame_size);
+      for (auto [reg, save_offset] : saves) mem(out, {MOp::SW, kNoReg, SP, reg, save_offset});
+    }
+    for (auto &inst : func.blocks[b].insts) {
+      if (inst.frame >= 0) {
+        inst.imm += offsets[inst.frame];
+        inst.frame = -1;
+      }
+      if (inst.flags & MInst::kIncoming) inst.imm += frame_size;
+      if (inst.op == MOp::RET) {
+        for (auto [reg, save_offset] : saves) mem(out, {MOp::LW, reg, SP, kNoReg, save_offset});
+        adjust_sp(out, frame_size);
+        out.push_back(std::move(inst));
+      } else if (inst.op == MOp::ADDI && inst.rs1 == SP && !FitsImm12(inst.imm)) {
+        out.push_back({MOp::LI, T6, kNoReg, kNoReg, inst.imm});
+        out.push_back({MOp::ADD, inst.rd, SP, T6});
+      } else if (inst.op == MOp::LW || inst.op == MOp::SW) {
+        mem(out, std::move(inst));
+      } else {
+        out.push_back(std::move(inst));
+      }
+    }
+    func.blocks[b].insts = std::move(out);
+  }
+}
+
+inline const char *OpName(MOp op) {
+  switch (op) {
+    case MOp::LI: return "li";
+    case MOp::LA: return "la";
+    case MOp::MV: return "mv";
+    case MOp::ADD: return "add";
+    case MOp::ADDI: return "addi";
+    case MOp::SUB: return "sub";
+    case MOp::MUL: return "mul";
+    case MOp::DIV: return "div";
+    case MOp::REM: return "rem";
+    case MOp::AND: return "and";
+    case MOp::OR: return "or";
+    case MOp::XOR: return "xor";
+    case MOp::XORI: return "xori";
+    case MOp::SLL: return "sll";
+    case MOp::SLLI: return "slli";
+    case MOp::SRL: return "srl";
+    case MOp::SRA: return "sra";
+    case MOp::SLT: return "slt";
+    case MOp::SEQZ: return "seqz";
+    case MOp::SNEZ: return "snez";
+    case MOp::LW: return "lw";
+    case MOp::SW: return "sw";
+    case MOp::J: return "j";
+    case MOp::BEQZ: return "beqz";
+    case MOp::BNEZ: return "bnez";
+    case MOp::BEQ: return "beq";
+    case MOp::BNE: return "bne";
+    case MOp::BLT: return "blt";
+    case MOp::BGE: return "bge";
+    case MOp::CALL: return "call";
+    case MOp::RET: return "ret";
+  }
+  return "";
+}
+
+inline void PrintInst(std::ostream &out, const MInst &inst) {
+  out << "  " << OpName(inst.op);
+  switch (inst.op) {
+    case MOp::LI: out << " " << RegName(inst.rd) << ", " << inst.imm; break;
+    case MOp::LA: out << " " << RegName(inst.rd) << ", " << inst.sym; break;
+    case MOp::MV:
+    case MOp::SEQZ:
+    case MOp::SNEZ: out << " " << RegName(inst.rd) << ", " << RegName(inst.rs1); break;
+    case MOp::ADDI:
+    case MOp::XORI:
+    case MOp::SLLI:
+      out << " " << RegName(inst.rd) << ", " << RegName(inst.rs1) << ", " << inst.imm;
+      break;
+    case MOp::LW: out << " " << RegName(inst.rd) << ", " << inst.imm << "(" << RegName(inst.rs1) << ")"; break;
+    case MOp::SW: out << " " << RegName(inst.rs2) << ", " << inst.imm << "(" << RegName(inst.rs1) << ")"; break;
+    case MOp::J:
+    case MOp::CALL: out << " " << inst.sym; break;
+    case MOp::BEQZ:
+    case MOp::BNEZ: out << " " << RegName(inst.rs1) << ", " << inst.sym; break;
+    case MOp::BEQ:
+    case MOp::BNE:
+    case MOp::BLT:
+    case MOp::BGE:
+      out << " " << RegName(inst.rs1) << ", " << RegName(inst.rs2) << ", " << inst.sym;
+      break;
+    case MOp::RET: break;
+    default:
+      out << " " << RegName(inst.rd) << ", " << RegName(inst.rs1) << ", " << RegName(inst.rs2);
+      break;
+  }
+  out << "\n";
+}
+
+inline void PrintFunction(std::ostream &out, const MFunction &func) {
+  out << ".text\n";
+  out << ".globl " << func.name << "\n";
+  out << func.name << ":\n";
+  for (size_t b = 0; b < func.blocks.size(); ++b) {
+    if (b > 0) out << func.blocks[b].label << ":\n";
+    for (const auto &inst : func.blocks[b].insts) PrintInst(out, inst);
+  }
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 任务的输出：text 写到主输出，report 写到附带的报告流（如代价报告）
+struct TaskResult {
+  std::string text;
+  std::string report;
+
+  TaskResult(std::string text = "", std::string report = "")
+      : text(std::move(text)), report(std::move(report)) {}
+
+  TaskResult &operator+=(const TaskResult &other) {
+    text += other.text;
+    report += other.report;
+    return *this;
+  }
+};
+
+// 按提交顺序输出结果的线程池。任务可以在任意线程上乱序完成，但结果总是按提交
+// 顺序写到 out，因此无论开多少线程，输出都与串行执行逐字节相同。
+// 空闲线程总是从共享队列取下一个任务，任务之间互相独立，不需要额外的负载均衡。
+// jobs <= 1 时不创建线程，任务直接在提交线程上执行。
+class OrderedTaskPool {
+  public:
+   using Task = std::function<TaskResult()>;
+
+   OrderedTaskPool(int jobs, std::ostream &out, std::ostream *report = nullptr)
+      : out(out), report(report) {
+    for (int i = 0; jobs > 1 && i < jobs; ++i) workers.emplace_back([this] { Work(); });
+  }
+
+   ~OrderedTaskPool() { Finish(); }
+
+   // 返回任务的编号，按提交顺序从 0 开始
+   size_t Submit(Task task) {
+    if (workers.empty()) {
+      Write(task());
+      ++next_output;
+      return next_submit++;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    // 限制已提交但尚未输出的任务数，避免生产者跑得太快占满内存
+    space.wait(lock, [this] { return next_submit - next_output < 4 * workers.size(); });
+    tasks.emplace_back(next_submit, std::move(task));
+    ready.notify_one();
+    return next_submit++;
+  }
+
+   // 已经完成并输出的任务数，编号小于它的任务都已结束
+   size_t Completed() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return next_output;
+  }
+
+   // 等待所有任务完成并输出
+   void Finish() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      done = true;
+    }
+    ready.notify_all();
+    for (auto &worker : workers) worker.join();
+    workers.clear();
+  }
+
+  private:
+   std::ostream &out;
+   std::ostream *report;
+   std::vector<std::thread> workers;
+   std::mutex mutex;
+   std::condition_variable ready, space;
+   std::deque<std::pair<size_t, Task>> tasks;
+   std::map<size_t, TaskResult> results;
+   size_t next_submit = 0;
+   size_t next_output = 0;
+   bool done = false;
+
+   void Write(const TaskResult &result) {
+    out << result.text;
+    if (report) *report << result.report;
+  }
+
+   void Work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+      ready.wait(lock, [this] { return done || !tasks.empty(); });
+      if (tasks.empty()) return;
+      auto [id, task] = std::move(tasks.front());
+      tasks.pop_front();
+      lock.unlock();
+      TaskResult result = task();
+      lock.lock();
+      results.emplace(id, std::move(result));
+      // 输出所有已经连续完成的结果
+      for (auto it = results.begin(); it != results.end() && it->first == next_output;
+           it = results.erase(it)) {
+        Write(it->second);
+        ++next_output;
+      }
+      space.notify_all();
+    }
+  }
+};
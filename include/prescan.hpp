@@ -0,0 +1,164 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 词法分析前的预扫描。把每一段连续的空白和注释压缩成一个分隔符：段内有换行时输出同样数目的
+// 换行（yylineno 不变），否则输出一个空格。记号之间只要有分隔就不影响切分，所以 Flex 看到的
+// 记号序列与原输入相同，而缩进和注释不再逐字节经过 Flex 的 DFA。
+// x86-64 上用 SSE2 每次检查 16 字节，其他平台逐字节处理。
+
+inline bool IsPrescanSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+// 返回 [p, end) 中第一个非空白字符的位置，newlines 加上跳过的换行数
+inline const char *SkipWhiteSpace(const char *p, const char *end, size_t &newlines) {
+#if defined(__SSE2__)
+  const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t');
+  const __m128i lf = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i is_lf = _mm_cmpeq_epi8(v, lf);
+    __m128i is_space = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+                                    _mm_or_si128(is_lf, _mm_cmpeq_epi8(v, cr)));
+    unsigned others = ~_mm_movemask_epi8(is_space) & 0xffff;
+    unsigned lf_mask = _mm_movemask_epi8(is_lf);
+    if (others) {
+      int k = __builtin_ctz(others);
+      newlines += __builtin_popcount(lf_mask & ((1u << k) - 1));
+      return p + k;
+    }
+    newlines += __builtin_popcount(lf_mask);
+    p += 16;
+  }
+#endif
+  for (; p < end && IsPrescanSpace(*p); ++p) newlines += *p == '\n';
+  return p;
+}
+
+// 返回 [p, end) 中第一个 "*/" 的位置，没有时返回 nullptr
+inline const char *FindCommentEnd(const char *p, const char *end) {
+#if defined(__SSE2__)
+  const __m128i star = _mm_set1_epi8('*'), slash = _mm_set1_epi8('/');
+  while (end - p >= 17) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1));
+    unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, star), _mm_cmpeq_epi8(b, slash)));
+    if (mask) return p + __builtin_ctz(mask);
+    p += 16;
+  }
+#endif
+  for (; end - p >= 2; ++p) {
+    if (p[0] == '*' && p[1] == '/') return p;
+  }
+  return nullptr;
+}
+
+// 分块预扫描。输入可以在任意位置切成块依次送入，跨块的空白、注释和还不能判断是除号还是注释
+// 开头的 "/" 记在状态里，输出与整体预扫描相同，内存只与块大小有关。
+// 没有结尾的块注释整体输出为一个分隔符加上 "/*"，Flex 同样会在这里报错
+class Prescanner {
+  public:
+   // 预扫描 [in, in + size)，结果追加到 out；last 表示这是最后一块
+   void Feed(const char *in, size_t size, bool last, std::string &out) {
+    const char *p = in, *end = in + size;
+    while (p < end) {
+      switch (state) {
+        case kToken: {
+          // 复制记号，直到可能开始空白或注释的位置
+          const char *token = p;
+          while (p < end && !IsPrescanSpace(*p) && *p != '/') ++p;
+          out.append(token, p);
+          if (p < end) state = *p == '/' ? (++p, kSlash) : kGap;
+          break;
+        }
+        case kGap: {
+          const char *gap = p;
+          p = SkipWhiteSpace(p, end, newlines);
+          in_gap |= p != gap;
+          if (p == end) break;
+          if (*p == '/') {
+            ++p;
+            state = kSlash;
+          } else {
+            EndGap(out);
+            state = kToken;
+          }
+          break;
+        }
+        case kSlash:
+          if (*p == '/' || *p == '*') {
+            in_gap = true;
+            star = false;
+            state = *p++ == '/' ? kLineComment : kBlockComment;
+          } else {
+            // 除号，其后的字符留给 kToken
+            EndGap(out);
+            out.push_back('/');
+            state = kToken;
+          }
+          break;
+        case kLineComment: {
+          // 行注释到换行为止，换行留给 kGap 作为空白
+          auto lf = static_cast<const char *>(std::memchr(p, '\n', end - p));
+          p = lf ? lf : end;
+          if (lf) state = kGap;
+          break;
+        }
+        case kBlockComment: {
+          if (star && *p == '/') {
+            // 上一块以 "*" 结尾，"*/" 跨在两块之间
+            ++p;
+            state = kGap;
+            break;
+          }
+          const char *close = FindCommentEnd(p, end);
+          if (close) {
+            newlines += std::count(p, close, '\n');
+            p = close + 2;
+            state = kGap;
+          } else {
+            newlines += std::count(p, end, '\n');
+            star = end[-1] == '*';
+            p = end;
+          }
+          break;
+        }
+      }
+    }
+    if (!last) return;
+    if (state == kSlash) {
+      EndGap(out);
+      out.push_back('/');
+    } else {
+      EndGap(out);
+      if (state == kBlockComment) out += "/*";
+    }
+    *this = Prescanner();
+  }
+
+  private:
+   enum State { kToken, kGap, kSlash, kLineComment, kBlockComment } state = kToken;
+   bool in_gap = false;   // 当前这段空白和注释是否已经有内容
+   bool star = false;     // 块注释中上一块的最后一个字符是 "*"
+   size_t newlines = 0;   // 当前这段空白和注释中的换行数
+
+   // 一段空白和注释结束：段内有换行时输出同样数目的换行，否则输出一个空格
+   void EndGap(std::string &out) {
+    if (!in_gap) return;
+    if (newlines) out.append(newlines, '\n');
+    else out.push_back(' ');
+    in_gap = false;
+    newlines = 0;
+  }
+};
+
+inline std::string Prescan(const char *in, size_t size) {
+  std::string out;
+  out.reserve(size);
+  Prescanner().Feed(in, size, true, out);
+  return out;
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "mir.hpp"
+
+// 基本块执行计数的剖析数据。
+// 文件由若干条记录组成，每条记录是若干小端 32 位字：函数名的哈希、基本块数、
+// 再按 Koopa IR 中的顺序给出每个基本块的执行次数。插桩的 RISC-V 程序和 -run 的解释器
+// 写出同样的格式，-fprofile-use 按函数名和基本块数匹配，源码改动后对不上的函数被忽略。
+
+inline const char *const kDefaultProfilePath = "sysy.prof";
+
+inline uint32_t ProfileNameHash(std::string_view name) {
+  uint32_t hash = 2166136261u;
+  for (char c : name) hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+  return hash;
+}
+
+inline void AppendProfileWord(std::string &out, uint32_t word) {
+  for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>(word >> (8 * i)));
+}
+
+class Profile {
+  public:
+   bool Load(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    size_t words = data.size() / 4, pos = 0;
+    auto word = [&](size_t i) {
+      uint32_t w = 0;
+      for (int k = 0; k < 4; ++k) w |= static_cast<uint32_t>(static_cast<uint8_t>(data[4 * i + k])) << (8 * k);
+      return w;
+    };
+    while (pos + 2 <= words) {
+      uint32_t hash = word(pos), blocks = word(pos + 1);
+      pos += 2;
+      if (pos + blocks > words) return false;
+      auto &counts = functions[hash];
+      counts.resize(blocks, 0);
+      for (uint32_t b = 0; b < blocks; ++b) counts[b] += word(pos + b);
+      pos += blocks;
+    }
+    return pos == words;
+  }
+
+   // 函数 name 的各基本块计数，没有记录或基本块数不符时返回 nullptr
+   const std::vector<uint64_t> *Find(std::string_view name, size_t blocks) const {
+    auto it = functions.find(ProfileNameHash(name));
+    if (it == functions.end() || it->second.size() != blocks) return nullptr;
+    return &it->second;
+  }
+
+  private:
+   std::unordered_map<uint32_t, std::vector<uint64_t>> functions;
+};
+
+// 插桩：函数 name 的计数器记录的标号，记录放在 sysy_prof 段。用 '.' 分隔，
+// 不会与运行时的 .Lprof_dump 等标号重名
+inline std::string ProfileRecordLabel(const std::string &name) { return ".Lprof." + name; }
+
+// 函数的计数器记录
+inline std::string ProfileRecordAsm(const std::string &name, size_t blocks) {
+  std::string out = ".section sysy_prof, \"aw\"\n.p2align 2\n";
+  out += ProfileRecordLabel(name) + ":\n";
+  out += "  .word " + std::to_string(ProfileNameHash(name)) + ", " + std::to_string(blocks) + "\n";
+  out += "  .zero " + std::to_string(4 * blocks) + "\n";
+  return out;
+}
+
+// 在每个基本块开头给对应的计数器加一。放在寄存器分配之后，只用不参与分配的 t5/t6，
+// t5 只在单条指令的重新载入中临时使用，基本块开头不会活跃
+inline void InstrumentBlocks(MFunction &func) {
+  std::string record = ProfileRecordLabel(func.name);
+  for (size_t b = 0; b < func.blocks.size(); ++b) {
+    MInst addr{MOp::LA, T6};
+    addr.sym = record + "+" + std::to_string(8 + 4 * b);
+    std::vector<MInst> counter = {
+        addr,
+        {MOp::LW, T5, T6, kNoReg, 0},
+        {MOp::ADDI, T5, T5, kNoReg, 1},
+        {MOp::SW, kNoReg, T6, T5, 0},
+    };
+    auto &insts = func.blocks[b].insts;
+    insts.insert(insts.begin(), counter.begin(), counter.end());
+  }
+}
+
+// 程序退出时把整个 sysy_prof 段写到 path。链接器为段名是合法标识符的段提供
+// __start_/__stop_ 符号；写文件直接用 Linux 系统调用，不依赖运行库
+inline std::string ProfileRuntimeAsm(const std::string &path) {
+  std::string out;
+  out += ".text\n";
+  out += ".Lprof_dump:\n";
+  out += "  li a0, -100\n";   // AT_FDCWD
+  out += "  la a1, .Lprof_path\n";
+  out += "  li a2, 577\n";    // O_WRONLY | O_CREAT | O_TRUNC
+  out += "  li a3, 420\n";    // 0644
+  out += "  li a7, 56\n";     // openat
+  out += "  ecall\n";
+  out += "  bltz a0, .Lprof_dump_end\n";
+  out += "  mv t0, a0\n";
+  out += "  la a1, __start_sysy_prof\n";
+  out += "  la a2, __stop_sysy_prof\n";
+  out += "  sub a2, a2, a1\n";
+  out += "  li a7, 64\n";     // write
+  out += "  ecall\n";
+  out += "  mv a0, t0\n";
+  out += "  li a7, 57\n";     // close
+  out += "  ecall\n";
+  out += ".Lprof_dump_end:\n";
+  out += "  ret\n";
+  out += ".section .fini_array, \"aw\"\n.p2align 2\n  .word .Lprof_dump\n";
+  out += ".data\n.Lprof_path:\n  .asciz \"" + path + "\"\n";
+  return out;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cassert>
+#include <cstring>
+#include <unordered_set>
+#include <vector>
+
+#include "koopa.h"
+
+// 整程序模式：从 main 出发，沿调用和对全局变量的引用求出可达的函数和全局变量，
+// 得到只含这些对象的 raw program。函数和值本身仍归原 program 的 builder 所有，
+// 这里只重新组织顶层的两个 slice，所以原 program 要比 PrunedProgram 活得久
+class PrunedProgram {
+  public:
+   koopa_raw_program_t raw;
+
+   explicit PrunedProgram(const koopa_raw_program_t &program) {
+    for (uint32_t i = 0; i < program.funcs.len; ++i) {
+      auto func = reinterpret_cast<koopa_raw_function_t>(program.funcs.buffer[i]);
+      if (!strcmp(func->name, "@main")) ReachFunction(func);
+    }
+    assert(!worklist.empty() && "whole-program mode needs a main function");
+    while (!worklist.empty()) {
+      auto func = worklist.back();
+      worklist.pop_back();
+      for (uint32_t i = 0; i < func->bbs.len; ++i) {
+        auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        for (uint32_t j = 0; j < bb->insts.len; ++j) VisitInst(reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]));
+      }
+    }
+    // 保持原来的顺序，输出与整个程序一起编译时一致，只是少了不可达的部分
+    raw.values = Filter(program.values, values);
+    raw.funcs = Filter(program.funcs, funcs);
+  }
+
+  private:
+   std::unordered_set<const void *> reached;
+   std::vector<koopa_raw_function_t> worklist;
+   std::vector<const void *> values, funcs;
+
+   void ReachFunction(koopa_raw_function_t func) {
+    if (reached.insert(func).second) worklist.push_back(func);
+  }
+
+   // 全局变量只会直接作为指令的操作数出现，初值里只有常量
+   void Use(koopa_raw_value_t value) {
+    if (value && value->kind.tag == KOOPA_RVT_GLOBAL_ALLOC) reached.insert(value);
+  }
+
+   void VisitInst(koopa_raw_value_t inst) {
+    const auto &kind = inst->kind;
+    switch (kind.tag) {
+      case KOOPA_RVT_LOAD: Use(kind.data.load.src); break;
+      case KOOPA_RVT_STORE:
+        Use(kind.data.store.value);
+        Use(kind.data.store.dest);
+        break;
+      case KOOPA_RVT_GET_PTR: Use(kind.data.get_ptr.src); break;
+      case KOOPA_RVT_GET_ELEM_PTR: Use(kind.data.get_elem_ptr.src); break;
+      case KOOPA_RVT_CALL: ReachFunction(kind.data.call.callee); break;
+      default:
+        break;
+    }
+  }
+
+   koopa_raw_slice_t Filter(const koopa_raw_slice_t &slice, std::vector<const void *> &kept) {
+    for (uint32_t i = 0; i < slice.len; ++i) {
+      if (reached.count(slice.buffer[i])) kept.push_back(slice.buffer[i]);
+    }
+    return {kept.data(), static_cast<uint32_t>(kept.size()), slice.kind};
+  }
+};
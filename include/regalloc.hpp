@@ -0,0 +1,353 @@
+#pragma once
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "layout.hpp"
+#include "mir.hpp"
+
+// 寄存器分配：线性扫描。每个虚拟寄存器的活跃区间是它在线性指令序列中从第一次活跃到
+// 最后一次活跃的范围 [start, end)，按起点依次分配物理寄存器，分不到时溢出结束最晚的区间。
+// - 不跨调用的值优先放进调用者保存寄存器 t0-t3、a0-a7，不需要保存；
+// - 跨调用的值可以放进 s 寄存器，代价是序言和尾声各存取一次，同一个 s 寄存器再次使用时不再付；
+//   也可以留在调用者保存寄存器里，在它跨过的每个调用前后存取。两者按基本块执行次数比较，
+//   相同时选后者，它只在真正执行调用的路径上付代价；
+// - 只被 mv 进 a0-a7 的实参，以及从 a0-a7 移出的参数和返回值，优先与该寄存器分到一起，mv 随之消失。
+// 溢出的值放在栈槽里，使用前载入到 t4/t5，定值后立即写回；由 li/la/取栈地址定值的溢出值
+// 不占栈槽，在每个使用处重新计算。t4/t5 和留给栈帧布局、插桩的 t6 不参与分配。
+
+struct LiveInterval {
+  int start = INT_MAX;
+  int end = -1;
+  int hint = kNoReg;  // 与之 mv 的物理寄存器
+};
+
+inline bool Overlaps(int start1, int end1, int start2, int end2) { return start1 < end2 && start2 < end1; }
+
+// 指令读取的寄存器，包括 call 读取的实参寄存器和 ret 读取的 a0
+inline std::vector<int> AllocUses(const MInst &inst) {
+  std::vector<int> uses = InstUses(inst);
+  if (inst.op == MOp::CALL) {
+    for (int i = 0; i < inst.imm; ++i) uses.push_back(A0 + i);
+  }
+  if (inst.op == MOp::RET) uses.push_back(A0);
+  return uses;
+}
+
+inline bool IsAllocatable(int reg) {
+  return (reg >= T0 && reg <= T2) || reg == T3 || (reg >= A0 && reg <= A7) || IsCalleeSaved(reg);
+}
+
+inline void AllocateRegisters(MFunction &func) {
+  static const int kCallerSaved[] = {T0, T1, T2, T3, A7, A6, A5, A4, A3, A2, A1, A0};
+  static const int kCalleeSaved[] = {S0, S1, S2, S3, S4, S5, S6, S7, S8, S9, S10, S11};
+  size_t num_blocks = func.blocks.size();
+  int num_vregs = func.next_vreg - kVRegBase;
+
+  // 按块的顺序给指令编号
+  std::vector<int> block_start(num_blocks), block_end(num_blocks);
+  int num_insts = 0;
+  for (size_t b = 0; b < num_blocks; ++b) {
+    block_start[b] = num_insts;
+    num_insts += func.blocks[b].insts.size();
+    block_end[b] = num_insts;
+  }
+
+  // 活跃变量分析。只有在某个块里定值之前就被读取的虚拟寄存器才可能跨块活跃，
+  // 表达式的临时值都在块内用完，所以只给这些寄存器重新编号，用位图求解数据流方程
+  std::vector<std::vector<int>> upward(num_blocks);
+  std::vector<int> global(num_vregs, -1), globals;
+  {
+    std::vector<size_t> seen(num_vregs, SIZE_MAX), defined(num_vregs, SIZE_MAX);
+    for (size_t b = 0; b < num_blocks; ++b) {
+      for (const auto &inst : func.blocks[b].insts) {
+        for (int reg : InstUses(inst)) {
+          if (!IsVReg(reg)) continue;
+          int v = reg - kVRegBase;
+          if (defined[v] == b || seen[v] == b) continue;
+          seen[v] = b;
+          upward[b].push_back(v);
+          if (global[v] < 0) {
+            global[v] = globals.size();
+            globals.push_back(v);
+          }
+        }
+        if (IsVReg(inst.rd)) defined[inst.rd - kVRegBase] = b;
+      }
+    }
+  }
+  size_t words = (globals.size() + 63) / 64;
+  using Bits = std::vector<uint64_t>;
+  auto set = [](Bits &bits, int v) { bits[v >> 6] |= uint64_t(1) << (v & 63); };
+  std::vector<Bits> use(num_blocks, Bits(words)), def(num_blocks, Bits(words));
+  std::vector<Bits> live_in(num_blocks, Bits(words)), live_out(num_blocks, Bits(words));
+  for (size_t b = 0; b < num_blocks; ++b) {
+    for (int v : upward[b]) set(use[b], global[v]);
+    for (const auto &inst : func.blocks[b].insts) {
+      if (IsVReg(inst.rd) && global[inst.rd - kVRegBase] >= 0) set(def[b], global[inst.rd - kVRegBase]);
+    }
+  }
+  auto succs = BlockSuccessors(func);
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t b = num_blocks; b-- > 0;) {
+      for (size_t w = 0; w < words; ++w) {
+        uint64_t out = 0;
+        for (size_t s : succs[b]) out |= live_in[s][w];
+        uint64_t in = use[b][w] | (out & ~def[b][w]);
+        changed |= in != live_in[b][w] || out != live_out[b][w];
+        live_in[b][w] = in;
+        live_out[b][w] = out;
+      }
+    }
+  }
+  // 只访问位图中为 1 的位
+  auto for_each = [&](const Bits &bits, auto &&fn) {
+    for (size_t w = 0; w < words; ++w) {
+      for (uint64_t word = bits[w]; word; word &= word - 1) fn(globals[w * 64 + __builtin_ctzll(word)]);
+    }
+  };
+
+  // 活跃区间、物理寄存器被直接使用的范围和调用的位置
+  std::vector<LiveInterval> intervals(num_vregs);
+  std::vector<std::vector<std::pair<int, int>>> fixed(32);
+  std::vector<int> calls;
+  std::vector<uint64_t> call_counts;
+  auto extend = [&](int v, int start, int end) {
+    intervals[v].start = std::min(intervals[v].start, start);
+    intervals[v].end = std::max(intervals[v].end, end);
+  };
+  for (size_t b = 0; b < num_blocks; ++b) {
+    for_each(live_in[b], [&](int v) { extend(v, block_start[b], block_start[b]); });
+    for_each(live_out[b], [&](int v) { extend(v, block_end[b], block_end[b]); });
+    // 物理寄存器不跨基本块，块内没有定值就被读取的只有入口处的参数
+    std::vector<int> defined(32, -1);
+    int pos = block_start[b];
+    for (const auto &inst : func.blocks[b].insts) {
+      for (int reg : AllocUses(inst)) {
+        if (IsVReg(reg)) extend(reg - kVRegBase, pos, pos);
+        else if (IsAllocatable(reg)) fixed[reg].push_back({defined[reg] >= 0 ? defined[reg] : block_start[b], pos});
+      }
+      if (inst.op == MOp::CALL) {
+        calls.push_back(pos);
+        call_counts.push_back(std::max<uint64_t>(func.blocks[b].count, 1));
+        defined[A0] = defined[A1] = pos;
+        fixed[A0].push_back({pos, pos + 1});
+        fixed[A1].push_back({pos, pos + 1});
+      } else if (IsVReg(inst.rd)) {
+        extend(inst.rd - kVRegBase, pos, pos + 1);
+      } else if (IsAllocatable(inst.rd)) {
+        defined[inst.rd] = pos;
+        fixed[inst.rd].push_back({pos, pos + 1});
+      }
+      if (inst.op == MOp::MV && IsVReg(inst.rd) && IsAllocatable(inst.rs1)) intervals[inst.rd - kVRegBase].hint = inst.rs1;
+      if (inst.op == MOp::MV && IsVReg(inst.rs1) && IsAllocatable(inst.rd)) intervals[inst.rs1 - kVRegBase].hint = inst.rd;
+      ++pos;
+    }
+  }
+  // 合并成互不相交、按位置排好的范围
+  for (auto &ranges : fixed) {
+    std::sort(ranges.begin(), ranges.end());
+    std::vector<std::pair<int, int>> merged;
+    for (auto range : ranges) {
+      if (!merged.empty() && range.first <= merged.back().second) {
+        merged.back().second = std::max(merged.back().second, range.second);
+      } else {
+        merged.push_back(range);
+      }
+    }
+    ranges = std::move(merged);
+  }
+  auto fixed_free = [&](int reg, const LiveInterval &interval) {
+    const auto &ranges = fixed[reg];
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), interval.start,
+                               [](int pos, const std::pair<int, int> &range) { return pos < range.second; });
+    return it == ranges.end() || it->first >= interval.end;
+  };
+  // 区间跨过的调用的执行次数之和，没有跨过调用时为 0。用前缀和，长区间跨过大量调用时也是对数时间
+  std::vector<uint64_t> call_prefix(calls.size() + 1, 0);
+  for (size_t i = 0; i < calls.size(); ++i) call_prefix[i + 1] = call_prefix[i] + call_counts[i];
+  auto crossed_calls = [&](const LiveInterval &interval) {
+    auto first = std::lower_bound(calls.begin(), calls.end(), interval.start);
+    auto last = std::lower_bound(first, calls.end(), interval.end);
+    return call_prefix[last - calls.begin()] - call_prefix[first - calls.begin()];
+  };
+
+  // 线性扫描
+  std::vector<int> order;
+  for (int v = 0; v < num_vregs; ++v) {
+    if (intervals[v].start < intervals[v].end) order.push_back(v);
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&](int a, int b) { return intervals[a].start < intervals[b].start; });
+  std::vector<int> assigned(num_vregs, kNoReg);
+  std::vector<bool> save_around(num_vregs, false);  // 在跨过的调用前后存取
+  std::vector<bool> callee_used(32, false);
+  std::vector<int> freed_at(32, -1);  // 上一个占用该寄存器的区间的终点
+  std::vector<int> active;
+  uint64_t entry_count = std::max<uint64_t>(func.blocks[0].count, 1);
+  for (int v : order) {
+    const LiveInterval &interval = intervals[v];
+    active.erase(std::remove_if(active.begin(), active.end(),
+                                [&](int a) { return intervals[a].end <= interval.start; }),
+                 active.end());
+    std::vector<bool> occupied(32, false);
+    for (int a : active) occupied[assigned[a]] = true;
+    auto can_use = [&](int reg) { return reg != kNoReg && !occupied[reg] && fixed_free(reg, interval); };
+    auto first = [&](const int *regs, size_t n, bool used) {
+      for (size_t i = 0; i < n; ++i) {
+        if (callee_used[regs[i]] == used && can_use(regs[i])) return regs[i];
+      }
+      return int(kNoReg);
+    };
+    // 空闲最久的调用者保存寄存器，相邻的值不挤在同一个寄存器上，给指令调度留出余地
+    auto least_recent = [&]() {
+      int best = kNoReg;
+      for (int reg : kCallerSaved) {
+        if (can_use(reg) && (best == kNoReg || freed_at[reg] < freed_at[best])) best = reg;
+      }
+      return best;
+    };
+    uint64_t crossed = crossed_calls(interval);
+    int reg = kNoReg;
+    if (!crossed) {
+      if (can_use(interval.hint)) reg = interval.hint;
+      if (reg == kNoReg) reg = least_recent();
+      if (reg == kNoReg) reg = first(kCalleeSaved, 12, true);
+      if (reg == kNoReg) reg = first(kCalleeSaved, 12, false);
+    } else {
+      reg = first(kCalleeSaved, 12, true);
+      if (reg == kNoReg) {
+        int callee = first(kCalleeSaved, 12, false), caller = least_recent();
+        reg = callee != kNoReg && (caller == kNoReg || entry_count < crossed) ? callee : caller;
+      }
+    }
+    if (reg == kNoReg) {
+      // 溢出结束最晚的区间
+      int victim = -1;
+      for (int a : active) {
+        if (fixed_free(assigned[a], interval) && (victim < 0 || intervals[a].end > intervals[victim].end)) victim = a;
+      }
+      if (victim < 0 || intervals[victim].end <= interval.end) continue;
+      reg = assigned[victim];
+      assigned[victim] = kNoReg;
+      save_around[victim] = false;
+      active.erase(std::find(active.begin(), active.end(), victim));
+    }
+    assigned[v] = reg;
+    save_around[v] = crossed && IsCallerSaved(reg);
+    if (IsCalleeSaved(reg)) callee_used[reg] = true;
+    freed_at[reg] = interval.end;
+    active.push_back(v);
+  }
+  func.saved_regs.clear();
+  for (int reg : kCalleeSaved) {
+    if (callee_used[reg]) func.saved_regs.push_back(reg);
+  }
+
+  // 溢出的值中可以重新计算的
+  std::unordered_map<int, int> def_counts;
+  std::unordered_map<int, MInst> remat;
+  for (const auto &block : func.blocks) {
+    for (const auto &inst : block.insts) {
+      if (!IsVReg(inst.rd) || assigned[inst.rd - kVRegBase] != kNoReg) continue;
+      ++def_counts[inst.rd];
+      bool cheap = inst.op == MOp::LI || inst.op == MOp::LA ||
+                   (inst.op == MOp::ADDI && inst.rs1 == SP);
+      if (cheap) remat[inst.rd] = inst;
+    }
+  }
+  for (auto it = remat.begin(); it != remat.end();) {
+    if (def_counts[it->first] != 1) it = remat.erase(it);
+    else ++it;
+  }
+
+  std::unordered_map<int, int> slots;
+  auto slot = [&](int vreg) {
+    auto it = slots.find(vreg);
+    if (it != slots.end()) return it->second;
+    return slots[vreg] = func.NewFrameObject(4);
+  };
+  // 每个调用前后要存取的值
+  std::unordered_map<int, std::vector<int>> around;
+  for (int v = 0; v < num_vregs; ++v) {
+    if (!save_around[v]) continue;
+    auto it = std::lower_bound(calls.begin(), calls.end(), intervals[v].start);
+    for (; it != calls.end() && *it < intervals[v].end; ++it) around[*it].push_back(v + kVRegBase);
+  }
+
+  int pos = 0;
+  for (auto &block : func.blocks) {
+    std::vector<MInst> out;
+    for (auto &inst : block.insts) {
+      int inst_pos = pos++;
+      if (IsVReg(inst.rd) && remat.count(inst.rd)) continue;
+
+      const int scratch[] = {T4, T5};
+      int next = 0;
+      std::unordered_map<int, int> reloaded;
+      auto use = [&](int &reg) {
+        if (!IsVReg(reg)) return;
+        if (assigned[reg - kVRegBase] != kNoReg) {
+          reg = assigned[reg - kVRegBase];
+          return;
+        }
+        auto it = reloaded.find(reg);
+        if (it != reloaded.end()) {
+          reg = it->second;
+          return;
+        }
+        int phys = scratch[next++];
+        auto r = remat.find(reg);
+        if (r != remat.end()) {
+          MInst def = r->second;
+          def.rd = phys;
+          out.push_back(def);
+        } else {
+          MInst reload{MOp::LW, phys, SP, kNoReg, 0};
+          reload.frame = slot(reg);
+          reload.flags = MInst::kReload;
+          out.push_back(reload);
+        }
+        reloaded[reg] = phys;
+        reg = phys;
+      };
+      use(inst.rs1);
+      use(inst.rs2);
+
+      auto it = inst.op == MOp::CALL ? around.find(inst_pos) : around.end();
+      if (it != around.end()) {
+        for (int v : it->second) {
+          MInst save{MOp::SW, kNoReg, SP, assigned[v - kVRegBase], 0};
+          save.frame = slot(v);
+          save.flags = MInst::kSpill;
+          out.push_back(save);
+        }
+      }
+
+      int def = inst.rd;
+      bool spilled = IsVReg(def) && assigned[def - kVRegBase] == kNoReg;
+      if (IsVReg(def)) inst.rd = spilled ? T4 : assigned[def - kVRegBase];
+      if (inst.op != MOp::MV || inst.rd != inst.rs1) out.push_back(inst);
+      if (spilled) {
+        MInst spill{MOp::SW, kNoReg, SP, T4, 0};
+        spill.frame = slot(def);
+        spill.flags = MInst::kSpill;
+        out.push_back(spill);
+      }
+
+      if (it != around.end()) {
+        for (int v : it->second) {
+          MInst restore{MOp::LW, assigned[v - kVRegBase], SP, kNoReg, 0};
+          restore.frame = slot(v);
+          restore.flags = MInst::kReload;
+          out.push_back(restore);
+        }
+      }
+    }
+    block.insts = std::move(out);
+  }
+}
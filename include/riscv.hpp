@@ -1,39 +1,188 @@
 #pragma once
+#include <algorithm>
 #include <iostream>
 #include <string>
+#include <sstream>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
-void VisitProgram(const koopa_raw_program_t &program);
-void VisitSlice(const koopa_raw_slice_t &slice);
-void VisitFunction(const koopa_raw_function_t &func);
-void VisitBasicBlock(const koopa_raw_basic_block_t &bb);
-void VisitValue(const koopa_raw_value_t &value);
-void VisitReturn(const koopa_raw_return_t &ret);
-void VisitInteger(const koopa_raw_integer_t &integer);
+#include "parallel.hpp"
+#include "mir.hpp"
+#include "regalloc.hpp"
+#include "cost.hpp"
+#include "layout.hpp"
+#include "profile.hpp"
+#include "schedule.hpp"
 
-void VisitProgram(const koopa_raw_program_t &program) {
-  // 访问所有函数
-  VisitSlice(program.funcs);
+// 后端选项，由 main 在生成代码前设置
+struct BackendOptions {
+  bool cost_report = false;  // 为每个函数生成代价报告
+  LatencyModel latency;      // 代价估计和指令调度用的延迟
+  bool profile_generate = false;     // 插入基本块计数器
+  const Profile *profile = nullptr;  // 按剖析数据排布基本块
+};
+inline BackendOptions backend_options;
+inline CostSummary cost_summary;
+
+// 单个函数的代码生成状态。每个函数独享一份，标号和虚拟寄存器等编号只在函数内有效，
+// 因此不同函数可以在不同线程上并行生成。
+struct FunctionContext {
+  MFunction func;
+  size_t block = 0;  // 当前正在生成的基本块
+  std::unordered_map<koopa_raw_value_t, int> values;   // 指令结果所在的虚拟寄存器
+  std::unordered_map<koopa_raw_value_t, int> allocs;   // alloc 对应的栈帧对象
+  std::unordered_map<koopa_raw_basic_block_t, size_t> blocks;  // 基本块对应的 MBlock 下标
+
+  void Emit(MInst inst) { func.blocks[block].insts.push_back(std::move(inst)); }
+
+  const std::string &Label(koopa_raw_basic_block_t bb) { return func.blocks[blocks.at(bb)].label; }
+};
+
+void VisitProgram(const koopa_raw_program_t &program, OrderedTaskPool &pool, bool emit_data = true);
+TaskResult GenerateAsm(const koopa_raw_program_t &program, bool emit_data = true);
+TaskResult VisitGlobals(const koopa_raw_slice_t &values);
+TaskResult VisitFunction(const koopa_raw_function_t &func);
+void VisitSlice(const koopa_raw_slice_t &slice, FunctionContext &ctx);
+void VisitBasicBlock(const koopa_raw_basic_block_t &bb, FunctionContext &ctx);
+void VisitValue(const koopa_raw_value_t &value, FunctionContext &ctx);
+void VisitReturn(const koopa_raw_return_t &ret, FunctionContext &ctx);
+void VisitCall(const koopa_raw_value_t &value, FunctionContext &ctx);
+void VisitBinary(const koopa_raw_value_t &value, FunctionContext &ctx);
+int VisitOperand(const koopa_raw_value_t &value, FunctionContext &ctx);
+int VisitPointer(const koopa_raw_value_t &ptr, FunctionContext &ctx, int &frame);
+void VisitElemPtr(const koopa_raw_value_t &value, FunctionContext &ctx);
+bool IsFusedCompare(const koopa_raw_value_t &value);
+void VisitCompareBranch(const koopa_raw_value_t &cond, const std::string &target, FunctionContext &ctx);
+
+// 全局变量的数据作为第一个任务，之后每个函数作为一个任务提交给 pool，
+// 输出按函数在程序中的顺序拼接。emit_data 为 false 时 program 中的全局变量只是声明
+void VisitProgram(const koopa_raw_program_t &program, OrderedTaskPool &pool, bool emit_data) {
+  assert(program.funcs.kind == KOOPA_RSIK_FUNCTION);
+  if (emit_data && program.values.len) {
+    pool.Submit([values = program.values] { return VisitGlobals(values); });
+  }
+  for (size_t i = 0; i < program.funcs.len; ++i) {
+    auto func = reinterpret_cast<koopa_raw_function_t>(program.funcs.buffer[i]);
+    // 跳过函数声明
+    if (func->bbs.len == 0) continue;
+    pool.Submit([func] { return VisitFunction(func); });
+  }
+}
+
+// 在当前线程上生成整个程序的汇编和代价报告
+TaskResult GenerateAsm(const koopa_raw_program_t &program, bool emit_data) {
+  std::ostringstream out, report;
+  OrderedTaskPool pool(1, out, &report);
+  VisitProgram(program, pool, emit_data);
+  return {out.str(), report.str()};
+}
+
+// 类型占用的字节数
+size_t TypeSize(koopa_raw_type_t ty) {
+  if (ty->tag == KOOPA_RTT_ARRAY) return ty->data.array.len * TypeSize(ty->data.array.base);
+  return 4;
+}
+
+bool IsZeroInit(const koopa_raw_value_t &init) {
+  switch (init->kind.tag) {
+    case KOOPA_RVT_INTEGER: return init->kind.data.integer.value == 0;
+    case KOOPA_RVT_AGGREGATE: {
+      const auto &elems = init->kind.data.aggregate.elems;
+      for (size_t i = 0; i < elems.len; ++i) {
+        if (!IsZeroInit(reinterpret_cast<koopa_raw_value_t>(elems.buffer[i]))) return false;
+      }
+      return true;
+    }
+    default: return true;  // zeroinit/undef
+  }
+}
+
+// 逐字写出数据，连续的 0 合并成一条 .zero，输出大小只与非零数据的多少有关
+class DataWriter {
+  public:
+   explicit DataWriter(std::ostream &out) : out(out) {}
+
+   ~DataWriter() { Flush(); }
+
+   void Word(int32_t word) {
+    if (word == 0) {
+      zeros += 4;
+      return;
+    }
+    Flush();
+    out << "  .word " << word << "\n";
+  }
+
+   void Zero(uint64_t bytes) { zeros += bytes; }
+
+   void Flush() {
+    if (zeros) out << "  .zero " << zeros << "\n";
+    zeros = 0;
+  }
+
+  private:
+   std::ostream &out;
+   uint64_t zeros = 0;  // 还没有写出的连续 0 的字节数
+};
+
+// 全局变量的段和标号，全 0 的放进 .bss，其余放进 .data
+void GlobalHeader(std::ostream &out, const std::string &name, bool zero) {
+  out << (zero ? ".bss\n" : ".data\n");
+  out << ".globl " << name << "\n";
+  out << ".p2align 2\n";
+  out << name << ":\n";
+}
+
+void VisitGlobalInit(const koopa_raw_value_t &init, DataWriter &data);
+
+TaskResult VisitGlobals(const koopa_raw_slice_t &values) {
+  std::ostringstream out;
+  for (size_t i = 0; i < values.len; ++i) {
+    auto value = reinterpret_cast<koopa_raw_value_t>(values.buffer[i]);
+    assert(value->kind.tag == KOOPA_RVT_GLOBAL_ALLOC);
+    auto init = value->kind.data.global_alloc.init;
+    bool zero = IsZeroInit(init);
+    GlobalHeader(out, value->name + 1, zero);
+    {
+      DataWriter data(out);
+      if (zero) data.Zero(TypeSize(value->ty->data.pointer.base));
+      else VisitGlobalInit(init, data);
+    }
+    out << "\n";
+  }
+  return out.str();
+}
+
+// 按顺序写出初值
+void VisitGlobalInit(const koopa_raw_value_t &init, DataWriter &data) {
+  switch (init->kind.tag) {
+    case KOOPA_RVT_INTEGER: data.Word(init->kind.data.integer.value); break;
+    case KOOPA_RVT_AGGREGATE: {
+      const auto &elems = init->kind.data.aggregate.elems;
+      for (size_t i = 0; i < elems.len; ++i)
+        VisitGlobalInit(reinterpret_cast<koopa_raw_value_t>(elems.buffer[i]), data);
+      break;
+    }
+    default:  // zeroinit/undef
+      data.Zero(TypeSize(init->ty));
+      break;
+  }
 }
 
 // 访问 raw slice
-void VisitSlice(const koopa_raw_slice_t &slice) {
+void VisitSlice(const koopa_raw_slice_t &slice, FunctionContext &ctx) {
   for (size_t i = 0; i < slice.len; ++i) {
     auto ptr = slice.buffer[i];
     // 根据 slice 的 kind 决定将 ptr 视作何种元素
     switch (slice.kind) {
-      case KOOPA_RSIK_FUNCTION:
-        // 访问函数
-        VisitFunction(reinterpret_cast<koopa_raw_function_t>(ptr));
-        break;
       case KOOPA_RSIK_BASIC_BLOCK:
         // 访问基本块
-        VisitBasicBlock(reinterpret_cast<koopa_raw_basic_block_t>(ptr));
+        VisitBasicBlock(reinterpret_cast<koopa_raw_basic_block_t>(ptr), ctx);
         break;
       case KOOPA_RSIK_VALUE:
         // 访问指令
-        VisitValue(reinterpret_cast<koopa_raw_value_t>(ptr));
+        VisitValue(reinterpret_cast<koopa_raw_value_t>(ptr), ctx);
         break;
       default:
         assert(false);
@@ -41,64 +190,351 @@ void VisitSlice(const koopa_raw_slice_t &slice) {
   }
 }
 
-// 访问函数
-void VisitFunction(const koopa_raw_function_t &func) {
-  // 输出 RISC-V 汇编的函数头部
-  cout << ".text" << endl;
+// 访问函数：指令选择得到使用虚拟寄存器的 MFunction，再经寄存器分配和栈帧布局后输出。
+// 开启代价报告时，报告随汇编一起返回，由 pool 按相同的顺序写出
+TaskResult VisitFunction(const koopa_raw_function_t &func) {
+  FunctionContext ctx;
 
   // 去掉函数名中的 '@'
   string func_name = func->name;
   if (func_name[0] == '@') {
     func_name = func_name.substr(1);  // 移除第一个字符
   }
+  ctx.func.name = func_name;
+
+  // 先为所有基本块建立标号，跳转可能指向后面的块。函数名和块名之间用 SysY 标识符里
+  // 不会出现的 '.' 分隔，不同函数的块不会得到相同的标号
+  for (size_t i = 0; i < func->bbs.len; ++i) {
+    auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+    string label = ".L" + func_name + ".";
+    label += bb->name ? string(bb->name + 1) : std::to_string(i);
+    ctx.blocks[bb] = i;
+    ctx.func.blocks.push_back({label, {}});
+  }
 
-  cout << ".globl " << func_name << endl;
-  cout << func_name << ":" << endl;
+  // 参数在入口处先移进虚拟寄存器，之后的调用会改写 a0-a7
+  for (size_t i = 0; i < func->params.len; ++i) {
+    auto param = reinterpret_cast<koopa_raw_value_t>(func->params.buffer[i]);
+    int reg = ctx.func.NewVReg();
+    if (i < 8) {
+      ctx.Emit({MOp::MV, reg, static_cast<int>(A0 + i)});
+    } else {
+      MInst load{MOp::LW, reg, SP, kNoReg, static_cast<int32_t>(4 * (i - 8))};
+      load.flags = MInst::kIncoming;
+      ctx.Emit(load);
+    }
+    ctx.values[param] = reg;
+  }
 
   // 访问所有基本块
-  VisitSlice(func->bbs);
+  VisitSlice(func->bbs, ctx);
+
+  // 有剖析数据时按实际执行次数排布，否则按静态估计；寄存器分配也按这些次数权衡代价
+  size_t num_blocks = ctx.func.blocks.size();
+  auto counts = backend_options.profile ? backend_options.profile->Find(func_name, num_blocks) : nullptr;
+  if (counts) {
+    for (size_t i = 0; i < num_blocks; ++i) ctx.func.blocks[i].count = (*counts)[i];
+  } else {
+    EstimateBlockCounts(ctx.func);
+  }
+  AllocateRegisters(ctx.func);
+  ScheduleBlocks(ctx.func, backend_options.latency);
+  if (backend_options.profile_generate) InstrumentBlocks(ctx.func);
+  LayoutBlocks(ctx.func);
+  ElideFallthroughJumps(ctx.func);
+  LayoutFrame(ctx.func, HasCall(ctx.func));
+
+  TaskResult result;
+  std::ostringstream out;
+  PrintFunction(out, ctx.func);
+  if (backend_options.profile_generate) out << ProfileRecordAsm(func_name, num_blocks);
+  result.text = out.str();
+  if (backend_options.cost_report) {
+    CostStats stats;
+    result.report = CostReport(ctx.func, backend_options.latency, stats);
+    cost_summary.Add(stats);
+  }
+  return result;
 }
 
 
 // 访问基本块
-void VisitBasicBlock(const koopa_raw_basic_block_t &bb) {
+void VisitBasicBlock(const koopa_raw_basic_block_t &bb, FunctionContext &ctx) {
+  ctx.block = ctx.blocks.at(bb);
   // 遍历基本块中的每条指令
-  VisitSlice(bb->insts);
+  VisitSlice(bb->insts, ctx);
+}
+
+// 调用：前 8 个实参放进 a0-a7，其余存到栈顶的实参区，返回值从 a0 取出。
+// 实参先算进虚拟寄存器，寄存器分配会尽量直接把它们算进 a0-a7，省掉这里的 mv
+void VisitCall(const koopa_raw_value_t &value, FunctionContext &ctx) {
+  const auto &call = value->kind.data.call;
+  std::vector<int> args;
+  for (size_t i = 0; i < call.args.len; ++i) {
+    args.push_back(VisitOperand(reinterpret_cast<koopa_raw_value_t>(call.args.buffer[i]), ctx));
+  }
+  for (size_t i = 8; i < args.size(); ++i) {
+    ctx.Emit({MOp::SW, kNoReg, SP, args[i], static_cast<int32_t>(4 * (i - 8))});
+  }
+  ctx.func.outgoing_size = std::max<int32_t>(ctx.func.outgoing_size, 4 * (std::max<size_t>(args.size(), 8) - 8));
+  for (size_t i = 0; i < args.size() && i < 8; ++i) ctx.Emit({MOp::MV, static_cast<int>(A0 + i), args[i]});
+
+  MInst inst{MOp::CALL};
+  inst.sym = call.callee->name + 1;
+  inst.imm = std::min<size_t>(args.size(), 8);
+  ctx.Emit(inst);
+  if (value->ty->tag == KOOPA_RTT_INT32 && value->used_by.len) {
+    int rd = ctx.func.NewVReg();
+    ctx.Emit({MOp::MV, rd, A0});
+    ctx.values[value] = rd;
+  }
 }
 
 // 访问指令
-void VisitValue(const koopa_raw_value_t &value) {
+void VisitValue(const koopa_raw_value_t &value, FunctionContext &ctx) {
   const auto &kind = value->kind;
   switch (kind.tag) {
     case KOOPA_RVT_RETURN: {
       // 处理 return 指令
-      VisitReturn(kind.data.ret);
+      VisitReturn(kind.data.ret, ctx);
+      break;
+    }
+    case KOOPA_RVT_ALLOC: {
+      // 局部变量占一个栈帧对象
+      ctx.allocs[value] = ctx.func.NewFrameObject(TypeSize(value->ty->data.pointer.base));
+      break;
+    }
+    case KOOPA_RVT_LOAD: {
+      MInst inst{MOp::LW, kNoReg, kNoReg, kNoReg, 0};
+      inst.rs1 = VisitPointer(kind.data.load.src, ctx, inst.frame);
+      inst.rd = ctx.func.NewVReg();
+      ctx.values[value] = inst.rd;
+      ctx.Emit(inst);
+      break;
+    }
+    case KOOPA_RVT_STORE: {
+      MInst inst{MOp::SW, kNoReg, kNoReg, VisitOperand(kind.data.store.value, ctx), 0};
+      inst.rs1 = VisitPointer(kind.data.store.dest, ctx, inst.frame);
+      ctx.Emit(inst);
+      break;
+    }
+    case KOOPA_RVT_GET_ELEM_PTR: {
+      VisitElemPtr(value, ctx);
+      break;
+    }
+    case KOOPA_RVT_BINARY: {
+      // 与分支合并的比较在 br 处生成
+      if (!IsFusedCompare(value)) VisitBinary(value, ctx);
       break;
     }
-    case KOOPA_RVT_INTEGER: {
-      // 处理 integer 常量
-      VisitInteger(kind.data.integer);
+    case KOOPA_RVT_BRANCH: {
+      auto cond = kind.data.branch.cond;
+      if (IsFusedCompare(cond)) {
+        VisitCompareBranch(cond, ctx.Label(kind.data.branch.true_bb), ctx);
+      } else {
+        MInst br{MOp::BNEZ, kNoReg, VisitOperand(cond, ctx)};
+        br.sym = ctx.Label(kind.data.branch.true_bb);
+        ctx.Emit(br);
+      }
+      MInst jump{MOp::J};
+      jump.sym = ctx.Label(kind.data.branch.false_bb);
+      ctx.Emit(jump);
+      break;
+    }
+    case KOOPA_RVT_JUMP: {
+      MInst jump{MOp::J};
+      jump.sym = ctx.Label(kind.data.jump.target);
+      ctx.Emit(jump);
+      break;
+    }
+    case KOOPA_RVT_CALL: {
+      VisitCall(value, ctx);
       break;
     }
     default:
-      assert(false); 
+      assert(false);
+  }
+}
+
+// 取得操作数所在的寄存器：0 直接使用 zero，其他整数常量用 li 载入
+int VisitOperand(const koopa_raw_value_t &value, FunctionContext &ctx) {
+  if (value->kind.tag == KOOPA_RVT_INTEGER) {
+    int32_t int_val = value->kind.data.integer.value;
+    if (int_val == 0) return ZERO;
+    int reg = ctx.func.NewVReg();
+    ctx.Emit({MOp::LI, reg, kNoReg, kNoReg, int_val});
+    return reg;
+  }
+  auto it = ctx.values.find(value);
+  assert(it != ctx.values.end());
+  return it->second;
+}
+
+// 取得指针的地址：局部变量是 sp 加上栈帧对象 frame 的偏移，全局变量用 la 载入，
+// getelemptr 的结果已经在寄存器里
+int VisitPointer(const koopa_raw_value_t &ptr, FunctionContext &ctx, int &frame) {
+  frame = -1;
+  auto it = ctx.allocs.find(ptr);
+  if (it != ctx.allocs.end()) {
+    frame = it->second;
+    return SP;
   }
+  if (ptr->kind.tag != KOOPA_RVT_GLOBAL_ALLOC) return VisitOperand(ptr, ctx);
+  MInst la{MOp::LA, ctx.func.NewVReg()};
+  la.sym = ptr->name + 1;
+  ctx.Emit(la);
+  return la.rd;
+}
+
+// 数组元素的地址：基址加上下标乘元素大小，常量下标直接折进 addi 的立即数
+void VisitElemPtr(const koopa_raw_value_t &value, FunctionContext &ctx) {
+  const auto &gep = value->kind.data.get_elem_ptr;
+  int frame;
+  int base = VisitPointer(gep.src, ctx, frame);
+  int64_t elem_size = TypeSize(gep.src->ty->data.pointer.base->data.array.base);
+  int rd = ctx.func.NewVReg();
+  ctx.values[value] = rd;
+
+  auto index = gep.index;
+  if (index->kind.tag == KOOPA_RVT_INTEGER) {
+    int64_t offset = index->kind.data.integer.value * elem_size;
+    if (FitsImm12(offset)) {
+      MInst addr{MOp::ADDI, rd, base, kNoReg, static_cast<int32_t>(offset)};
+      addr.frame = frame;
+      ctx.Emit(addr);
+      return;
+    }
+  }
+  // 局部数组先算出首地址
+  if (frame >= 0) {
+    MInst addr{MOp::ADDI, ctx.func.NewVReg(), SP, kNoReg, 0};
+    addr.frame = frame;
+    ctx.Emit(addr);
+    base = addr.rd;
+  }
+  int scaled = ctx.func.NewVReg();
+  int index_reg = VisitOperand(index, ctx);
+  if ((elem_size & (elem_size - 1)) == 0) {
+    ctx.Emit({MOp::SLLI, scaled, index_reg, kNoReg, __builtin_ctzll(elem_size)});
+  } else {
+    int size_reg = ctx.func.NewVReg();
+    ctx.Emit({MOp::LI, size_reg, kNoReg, kNoReg, static_cast<int32_t>(elem_size)});
+    ctx.Emit({MOp::MUL, scaled, index_reg, size_reg});
+  }
+  ctx.Emit({MOp::ADD, rd, base, scaled});
+}
+
+// 比较的结果只被一条 br 用作条件时，不必把结果放进寄存器，直接生成比较跳转
+bool IsFusedCompare(const koopa_raw_value_t &value) {
+  if (value->kind.tag != KOOPA_RVT_BINARY || value->used_by.len != 1) return false;
+  switch (value->kind.data.binary.op) {
+    case KOOPA_RBO_EQ:
+    case KOOPA_RBO_NOT_EQ:
+    case KOOPA_RBO_LT:
+    case KOOPA_RBO_GT:
+    case KOOPA_RBO_LE:
+    case KOOPA_RBO_GE: break;
+    default: return false;
+  }
+  auto user = reinterpret_cast<koopa_raw_value_t>(value->used_by.buffer[0]);
+  return user->kind.tag == KOOPA_RVT_BRANCH && user->kind.data.branch.cond == value;
+}
+
+// 条件成立时跳到 target。Koopa 是 SSA，比较的操作数在 br 处仍然可用，推迟到这里生成不改变语义
+void VisitCompareBranch(const koopa_raw_value_t &cond, const std::string &target, FunctionContext &ctx) {
+  const auto &binary = cond->kind.data.binary;
+  int lhs = VisitOperand(binary.lhs, ctx);
+  int rhs = VisitOperand(binary.rhs, ctx);
+  MInst br;
+  switch (binary.op) {
+    case KOOPA_RBO_EQ: br = {MOp::BEQ, kNoReg, lhs, rhs}; break;
+    case KOOPA_RBO_NOT_EQ: br = {MOp::BNE, kNoReg, lhs, rhs}; break;
+    case KOOPA_RBO_LT: br = {MOp::BLT, kNoReg, lhs, rhs}; break;
+    case KOOPA_RBO_GT: br = {MOp::BLT, kNoReg, rhs, lhs}; break;
+    case KOOPA_RBO_LE: br = {MOp::BGE, kNoReg, rhs, lhs}; break;
+    case KOOPA_RBO_GE: br = {MOp::BGE, kNoReg, lhs, rhs}; break;
+    default: assert(false);
+  }
+  br.sym = target;
+  ctx.Emit(br);
+}
+
+// 处理二元运算。比较运算没有直接对应的指令，用 slt/xor 与 seqz/snez/xori 组合
+void VisitBinary(const koopa_raw_value_t &value, FunctionContext &ctx) {
+  const auto &binary = value->kind.data.binary;
+  int rd = ctx.func.NewVReg();
+  ctx.values[value] = rd;
+
+  // 加减一个 12 位立即数时使用 addi
+  auto rhs = binary.rhs;
+  if (rhs->kind.tag == KOOPA_RVT_INTEGER &&
+      (binary.op == KOOPA_RBO_ADD || binary.op == KOOPA_RBO_SUB)) {
+    int64_t imm = rhs->kind.data.integer.value;
+    if (binary.op == KOOPA_RBO_SUB) imm = -imm;
+    if (FitsImm12(imm)) {
+      ctx.Emit({MOp::ADDI, rd, VisitOperand(binary.lhs, ctx), kNoReg, static_cast<int32_t>(imm)});
+      return;
+    }
+  }
+
+  int lhs = VisitOperand(binary.lhs, ctx);
+  int rhs_reg = VisitOperand(rhs, ctx);
+  switch (binary.op) {
+    case KOOPA_RBO_EQ:
+    case KOOPA_RBO_NOT_EQ: {
+      // 与 0 比较时不需要先异或
+      int diff = lhs;
+      if (rhs_reg != ZERO) {
+        diff = ctx.func.NewVReg();
+        ctx.Emit({MOp::XOR, diff, lhs, rhs_reg});
+      }
+      ctx.Emit({binary.op == KOOPA_RBO_EQ ? MOp::SEQZ : MOp::SNEZ, rd, diff});
+      return;
+    }
+    case KOOPA_RBO_LT: ctx.Emit({MOp::SLT, rd, lhs, rhs_reg}); return;
+    case KOOPA_RBO_GT: ctx.Emit({MOp::SLT, rd, rhs_reg, lhs}); return;
+    case KOOPA_RBO_LE:
+    case KOOPA_RBO_GE: {
+      // a <= b 即 !(b < a)，a >= b 即 !(a < b)
+      int less = ctx.func.NewVReg();
+      if (binary.op == KOOPA_RBO_LE) ctx.Emit({MOp::SLT, less, rhs_reg, lhs});
+      else ctx.Emit({MOp::SLT, less, lhs, rhs_reg});
+      ctx.Emit({MOp::XORI, rd, less, kNoReg, 1});
+      return;
+    }
+    default: break;
+  }
+
+  MOp op;
+  switch (binary.op) {
+    case KOOPA_RBO_ADD: op = MOp::ADD; break;
+    case KOOPA_RBO_SUB: op = MOp::SUB; break;
+    case KOOPA_RBO_MUL: op = MOp::MUL; break;
+    case KOOPA_RBO_DIV: op = MOp::DIV; break;
+    case KOOPA_RBO_MOD: op = MOp::REM; break;
+    case KOOPA_RBO_AND: op = MOp::AND; break;
+    case KOOPA_RBO_OR: op = MOp::OR; break;
+    case KOOPA_RBO_XOR: op = MOp::XOR; break;
+    case KOOPA_RBO_SHL: op = MOp::SLL; break;
+    case KOOPA_RBO_SHR: op = MOp::SRL; break;
+    case KOOPA_RBO_SAR: op = MOp::SRA; break;
+    default: assert(false); return;
+  }
+  ctx.Emit({op, rd, lhs, rhs_reg});
 }
 
 // 处理 return 指令
-void VisitReturn(const koopa_raw_return_t &ret) {
+void VisitReturn(const koopa_raw_return_t &ret, FunctionContext &ctx) {
   // 获取 return 指令的返回值
   koopa_raw_value_t ret_value = ret.value;
-  // 返回值是一个 integer
-  if (ret_value->kind.tag == KOOPA_RVT_INTEGER) {
-    int32_t int_val = ret_value->kind.data.integer.value;
-    // 生成将立即数加载到 a0 寄存器的 RISC-V 汇编
-    cout << "  li a0, " << int_val << endl;
+  if (ret_value) {
+    if (ret_value->kind.tag == KOOPA_RVT_INTEGER) {
+      // 返回值是一个 integer，直接加载到 a0
+      ctx.Emit({MOp::LI, A0, kNoReg, kNoReg, ret_value->kind.data.integer.value});
+    } else {
+      ctx.Emit({MOp::MV, A0, VisitOperand(ret_value, ctx)});
+    }
   }
   // 生成 RISC-V 的 ret 指令
-  cout << "  ret" << endl;
+  ctx.Emit({MOp::RET});
 }
-
-// 处理 integer 指令
-void VisitInteger(const koopa_raw_integer_t &integer) {
-}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "cost.hpp"
+#include "mir.hpp"
+
+// 基本块内的表调度。放在寄存器分配之后，依赖图中除了写后读，还有分配带来的读后写、写后写，
+// 所以重排不会改写仍要使用的物理寄存器，溢出存取也一起参与调度。
+// 调用和块末尾的跳转是屏障，只在它们分开的各段之内重排；段过长时按 kScheduleWindow 切开，
+// 建图的代价与块长成线性。按估计的周期数不比原顺序少时保留原顺序。
+
+constexpr size_t kScheduleWindow = 64;
+
+inline bool IsMemory(MOp op) { return op == MOp::LW || op == MOp::SW; }
+
+// 两次访存是否可能访问同一个字：都以 sp 为基址时，不同栈帧对象、同一对象的不同偏移互不重叠；
+// 其余通过指针访问的都当作可能重叠
+inline bool MayAlias(const MInst &a, const MInst &b) {
+  if (a.rs1 != SP || b.rs1 != SP) return true;
+  if (a.frame != b.frame) return false;
+  return a.imm == b.imm && (a.flags & MInst::kIncoming) == (b.flags & MInst::kIncoming);
+}
+
+// 对 [begin, end) 中的指令做表调度，结果追加到 out
+inline void ScheduleRegion(const std::vector<MInst> &insts, size_t begin, size_t end, const LatencyModel &latency,
+                           std::vector<MInst> &out) {
+  size_t n = end - begin;
+  // succs[i] 是依赖 i 的指令和它最早可以在 i 之后多少个周期发射
+  std::vector<std::vector<std::pair<size_t, int>>> succs(n);
+  std::vector<int> preds(n, 0);
+  for (size_t j = 0; j < n; ++j) {
+    const MInst &later = insts[begin + j];
+    auto later_uses = InstUses(later);
+    for (size_t i = 0; i < j; ++i) {
+      const MInst &earlier = insts[begin + i];
+      auto earlier_uses = InstUses(earlier);
+      int delay = -1;
+      if (earlier.rd != kNoReg && std::count(later_uses.begin(), later_uses.end(), earlier.rd)) {
+        delay = latency.Of(earlier.op);
+      }
+      if (later.rd != kNoReg &&
+          (later.rd == earlier.rd || std::count(earlier_uses.begin(), earlier_uses.end(), later.rd))) {
+        delay = std::max(delay, 1);
+      }
+      if (IsMemory(earlier.op) && IsMemory(later.op) && (IsStore(earlier.op) || IsStore(later.op)) &&
+          MayAlias(earlier, later)) {
+        delay = std::max(delay, IsStore(earlier.op) ? latency.store : 1);
+      }
+      if (delay < 0) continue;
+      succs[i].push_back({j, delay});
+      ++preds[j];
+    }
+  }
+
+  // 优先级是到段末尾的最长延迟路径
+  std::vector<int> height(n, 0);
+  for (size_t i = n; i-- > 0;) {
+    height[i] = latency.Of(insts[begin + i].op);
+    for (auto [j, delay] : succs[i]) height[i] = std::max(height[i], delay + height[j]);
+  }
+
+  std::vector<uint64_t> ready_at(n, 0);
+  std::vector<size_t> ready;
+  for (size_t i = 0; i < n; ++i) {
+    if (!preds[i]) ready.push_back(i);
+  }
+  uint64_t cycle = 0;
+  while (!ready.empty()) {
+    // 已经就绪的指令中选最高的，都没就绪时选最早就绪的；相同时保持原顺序
+    auto better = [&](size_t a, size_t b) {
+      bool a_ready = ready_at[a] <= cycle, b_ready = ready_at[b] <= cycle;
+      if (a_ready != b_ready) return a_ready;
+      if (a_ready && height[a] != height[b]) return height[a] > height[b];
+      if (!a_ready && ready_at[a] != ready_at[b]) return ready_at[a] < ready_at[b];
+      return a < b;
+    };
+    auto best = std::min_element(ready.begin(), ready.end(), better);
+    size_t i = *best;
+    ready.erase(best);
+    uint64_t issue = std::max(cycle, ready_at[i]);
+    out.push_back(insts[begin + i]);
+    for (auto [j, delay] : succs[i]) {
+      ready_at[j] = std::max(ready_at[j], issue + delay);
+      if (!--preds[j]) ready.push_back(j);
+    }
+    cycle = issue + 1;
+  }
+}
+
+inline void ScheduleBlocks(MFunction &func, const LatencyModel &latency) {
+  for (auto &block : func.blocks) {
+    std::vector<MInst> out;
+    out.reserve(block.insts.size());
+    size_t begin = 0;
+    for (size_t i = 0; i <= block.insts.size(); ++i) {
+      bool barrier = i == block.insts.size() || block.insts[i].op == MOp::CALL || IsTerminator(block.insts[i].op);
+      if (!barrier && i - begin < kScheduleWindow) continue;
+      ScheduleRegion(block.insts, begin, i, latency, out);
+      if (barrier && i < block.insts.size()) out.push_back(block.insts[i]);
+      begin = barrier ? i + 1 : i;
+    }
+    MBlock scheduled{block.label, std::move(out), block.count};
+    if (EstimateBlock(scheduled, latency).cycles < EstimateBlock(block, latency).cycles) {
+      block.insts = std::move(scheduled.insts);
+    }
+  }
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+// 驻留后的标识符，比较名字只需比较整数
+using Symbol = uint32_t;
+
+// 标识符驻留表：所有名字以 '\0' 分隔存放在一块连续内存中，
+// 用开放寻址的哈希表查重，同一个名字只会分配一个 Symbol。
+class Interner {
+  public:
+   Interner() : slots(64, 0) {}
+
+   Symbol Intern(const char *str, size_t len) {
+    uint32_t hash = Hash(str, len);
+    size_t mask = slots.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      uint32_t slot = slots[i];
+      if (slot == 0) break;
+      Symbol sym = slot - 1;
+      if (hashes[sym] == hash && lengths[sym] == len &&
+          std::memcmp(storage.data() + offsets[sym], str, len) == 0)
+        return sym;
+    }
+
+    Symbol sym = offsets.size();
+    offsets.push_back(storage.size());
+    lengths.push_back(len);
+    hashes.push_back(hash);
+    storage.insert(storage.end(), str, str + len);
+    storage.push_back('\0');
+    // 装载因子超过 1/2 时扩容
+    if (offsets.size() * 2 > slots.size()) Grow();
+    else Insert(sym);
+    return sym;
+  }
+
+   Symbol Intern(std::string_view str) { return Intern(str.data(), str.size()); }
+
+   // 返回的视图在下一次 Intern 之前有效
+   std::string_view Name(Symbol sym) const {
+    return std::string_view(storage.data() + offsets[sym], lengths[sym]);
+  }
+
+  private:
+   std::vector<char> storage;
+   std::vector<uint32_t> offsets, lengths, hashes;
+   std::vector<uint32_t> slots;  // Symbol + 1，0 表示空
+
+   static uint32_t Hash(const char *str, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) hash = (hash ^ static_cast<unsigned char>(str[i])) * 16777619u;
+    return hash;
+  }
+
+   void Insert(Symbol sym) {
+    size_t mask = slots.size() - 1;
+    size_t i = hashes[sym] & mask;
+    while (slots[i] != 0) i = (i + 1) & mask;
+    slots[i] = sym + 1;
+  }
+
+   void Grow() {
+    slots.assign(slots.size() * 2, 0);
+    for (Symbol sym = 0; sym < offsets.size(); ++sym) Insert(sym);
+  }
+};
+
+// 整个编译过程共享的驻留表
+inline Interner symbols;
+
+struct Keyword {
+  const char *text;
+  int token;
+};
+
+// 编译期生成的关键字完美哈希表：构造时搜索一个种子，使所有关键字落在不同的槽位，
+// 查找只需一次哈希、一次长度比较和一次 memcmp。
+template <size_t N>
+class KeywordTable {
+  public:
+   static constexpr size_t kSize = 32;
+   static_assert(N <= kSize, "too many keywords");
+
+   constexpr KeywordTable(const Keyword (&keywords)[N]) {
+    for (uint32_t s = 1;; ++s) {
+      if (TryBuild(keywords, s)) {
+        seed = s;
+        break;
+      }
+    }
+  }
+
+   // 是关键字时返回其 token，否则返回 0
+   int Find(const char *str, size_t len) const {
+    if (len == 0) return 0;
+    const Entry &entry = table[Slot(str, len, seed)];
+    if (entry.len != len || std::memcmp(entry.text, str, len) != 0) return 0;
+    return entry.token;
+  }
+
+  private:
+   struct Entry {
+    const char *text = nullptr;
+    size_t len = 0;
+    int token = 0;
+  };
+   Entry table[kSize] = {};
+   uint32_t seed = 0;
+
+   static constexpr size_t Length(const char *str) {
+    size_t len = 0;
+    while (str[len]) ++len;
+    return len;
+  }
+
+   static constexpr size_t Slot(const char *str, size_t len, uint32_t seed) {
+    uint32_t hash = static_cast<uint32_t>(len) * seed;
+    hash ^= static_cast<unsigned char>(str[0]) * (seed * 2 + 1);
+    hash ^= static_cast<unsigned char>(str[len - 1]) * (seed * 4 + 3);
+    return (hash ^ (hash >> 7)) % kSize;
+  }
+
+   constexpr bool TryBuild(const Keyword (&keywords)[N], uint32_t s) {
+    for (auto &entry : table) entry = Entry();
+    for (const auto &keyword : keywords) {
+      size_t len = Length(keyword.text);
+      Entry &entry = table[Slot(keyword.text, len, s)];
+      if (entry.text) return false;
+      entry = Entry{keyword.text, len, keyword.token};
+    }
+    return true;
+  }
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "symbol.hpp"
+
+// 符号表中的一项。常量在编译期求值，使用处直接替换成立即数，不产生 load。
+struct SymbolInfo {
+  enum Kind { kConst, kVar, kArray, kConstArray } kind;
+  int32_t value;        // 常量的值，数组的长度
+  std::string ir_name;  // 变量对应的 Koopa 名字，局部变量如 %_x_0，全局变量如 @x
+  uint32_t depth;       // 声明所在的作用域深度
+};
+
+// 作用域栈式符号表。
+// 所有作用域共用一张以 Symbol 为键的开放寻址表，表中记录名字当前可见的那一项；
+// 声明时把被遮蔽的旧项记入撤销日志，弹出作用域时按日志逐条恢复，
+// 代价只与该作用域内的声明数成正比，和外层作用域的大小无关。每条声明只撤销一次，
+// 所以弹出作用域的总代价与声明总数成正比。
+class ScopedSymbolTable {
+  public:
+   ScopedSymbolTable() : keys(64, kEmpty), bindings(64, kUnbound) {}
+
+   void PushScope() { scope_marks.push_back(undo_log.size()); }
+
+   void PopScope() {
+    assert(!scope_marks.empty());
+    size_t mark = scope_marks.back();
+    scope_marks.pop_back();
+    while (undo_log.size() > mark) {
+      const Undo &undo = undo_log.back();
+      bindings[undo.slot] = undo.prev;
+      undo_log.pop_back();
+    }
+    entries.resize(mark);
+  }
+
+   uint32_t Depth() const { return scope_marks.size(); }
+
+   // 在当前作用域中声明 sym，同一作用域内不允许重复声明
+   const SymbolInfo &Declare(Symbol sym, SymbolInfo info) {
+    size_t slot = FindSlot(sym);
+    int32_t prev = bindings[slot];
+    info.depth = Depth();
+    assert((prev == kUnbound || entries[prev].depth != info.depth) && "redefinition");
+    undo_log.push_back({static_cast<uint32_t>(slot), prev});
+    entries.push_back(std::move(info));
+    bindings[slot] = entries.size() - 1;
+    return entries.back();
+  }
+
+   // 查找 sym 当前可见的声明，找不到返回 nullptr
+   const SymbolInfo *Lookup(Symbol sym) const {
+    size_t mask = keys.size() - 1;
+    for (size_t i = Hash(sym) & mask; keys[i] != kEmpty; i = (i + 1) & mask) {
+      if (keys[i] == sym) return bindings[i] == kUnbound ? nullptr : &entries[bindings[i]];
+    }
+    return nullptr;
+  }
+
+  private:
+   static constexpr Symbol kEmpty = ~Symbol(0);
+   static constexpr int32_t kUnbound = -1;
+
+   struct Undo {
+    uint32_t slot;
+    int32_t prev;
+  };
+
+   // 键一旦插入就不再删除，名字离开作用域后对应的 binding 恢复为 kUnbound；
+   // 每次声明恰好在撤销日志里留下一条记录，所以 entries 与 undo_log 等长
+   std::vector<Symbol> keys;
+   std::vector<int32_t> bindings;
+   size_t used = 0;
+   std::vector<SymbolInfo> entries;
+   std::vector<Undo> undo_log;
+   std::vector<size_t> scope_marks;
+
+   static size_t Hash(Symbol sym) { return sym * 0x9e3779b1u; }
+
+   // 返回 sym 所在的槽位，不存在时插入
+   size_t FindSlot(Symbol sym) {
+    size_t mask = keys.size() - 1;
+    size_t i = Hash(sym) & mask;
+    for (; keys[i] != kEmpty; i = (i + 1) & mask) {
+      if (keys[i] == sym) return i;
+    }
+    if ((used + 1) * 2 > keys.size()) {
+      Grow();
+      return FindSlot(sym);
+    }
+    keys[i] = sym;
+    ++used;
+    return i;
+  }
+
+   // 扩容时槽位会变，撤销日志里记录的槽位也要一起重新映射
+   void Grow() {
+    std::vector<Symbol> old_keys(keys.size() * 2, kEmpty);
+    std::vector<int32_t> old_bindings(keys.size() * 2, kUnbound);
+    old_keys.swap(keys);
+    old_bindings.swap(bindings);
+    std::vector<uint32_t> remap(old_keys.size());
+    size_t mask = keys.size() - 1;
+    for (size_t j = 0; j < old_keys.size(); ++j) {
+      if (old_keys[j] == kEmpty) continue;
+      size_t i = Hash(old_keys[j]) & mask;
+      while (keys[i] != kEmpty) i = (i + 1) & mask;
+      keys[i] = old_keys[j];
+      bindings[i] = old_bindings[j];
+      remap[j] = i;
+    }
+    for (auto &undo : undo_log) undo.slot = remap[undo.slot];
+  }
+};
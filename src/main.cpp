@@ -1,66 +1,523 @@
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <csignal>
 #include <cstdio>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <sstream>
+#include <vector>
 
 #define MOD
 
 #include "../include/koopa.h"
 #include "../include/ast.hpp"
 #include "../include/riscv.hpp"
+#include "../include/cache.hpp"
+#include "../include/koopa_bin.hpp"
+#include "../include/interp.hpp"
+#include "../include/prune.hpp"
 
 using namespace std;
 
 extern FILE *yyin;
 extern int yyparse(unique_ptr<BaseAST> &ast);
+extern bool CheckPrescan(FILE *file, ostream &err);
+extern void RestartScanner(FILE *file);
 
+// compiler MODE INPUT -o OUTPUT 之后的可选参数
+struct Options {
+  string cache_dir;                 // --cache-dir=DIR，为空时不启用缓存
+  uint64_t cache_max_size = 256ULL << 20;  // --cache-max-size=BYTES
+  bool cache_stats = false;         // --cache-stats
+  int jobs = 1;                     // -j N，后端并行的线程数，不影响输出
+  string cost_report;               // --cost-report=FILE，-riscv 时把代价报告追加到 FILE
+  LatencyModel latency;             // -mtune=CPU 和 --lat-mul/--lat-div/--lat-load=CYCLES，代价估计和调度用的延迟
+  string profile_generate;          // -fprofile-generate[=FILE]，插桩，运行后把计数写到 FILE
+  string profile_use;               // -fprofile-use[=FILE]，按 FILE 中的计数排布基本块
+  bool check_prescan = false;       // --check-prescan，先确认预扫描不改变记号序列
+  string temp_report;               // --temp-report=FILE，把每个表达式同时活跃的临时值个数追加到 FILE
+  vector<string> whole_program;     // --whole-program=LIB[,LIB...]，与 LIB 合成一个程序
+  vector<string> flags;             // 其余参数，参与缓存键计算
+};
 
-int main(int argc, const char *argv[]) {
+static Options ParseOptions(int argc, const char *argv[]) {
+  Options opts;
+  // -mtune 先于 --lat-* 生效，后者在任何位置都能覆盖其中的单项
+  for (int i = 5; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg.rfind("-mtune=", 0) == 0) {
+      bool known = TuneLatency(arg.substr(7), opts.latency);
+      assert(known && "unknown -mtune");
+    }
+  }
+  for (int i = 5; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg.rfind("--cache-dir=", 0) == 0) opts.cache_dir = arg.substr(12);
+    else if (arg.rfind("--cache-max-size=", 0) == 0) opts.cache_max_size = stoull(arg.substr(17));
+    else if (arg == "--cache-stats") opts.cache_stats = true;
+    else if (arg == "-j" && i + 1 < argc) opts.jobs = stoi(argv[++i]);
+    else if (arg.rfind("-j", 0) == 0 && arg.size() > 2) opts.jobs = stoi(arg.substr(2));
+    else if (arg.rfind("--cost-report=", 0) == 0) opts.cost_report = arg.substr(14);
+    else if (arg == "--check-prescan") opts.check_prescan = true;
+    else if (arg.rfind("--temp-report=", 0) == 0) opts.temp_report = arg.substr(14);
+    else if (arg.rfind("--whole-program=", 0) == 0) {
+      stringstream ss(arg.substr(16));
+      string lib;
+      while (getline(ss, lib, ',')) opts.whole_program.push_back(lib);
+    }
+    else {
+      if (arg == "-fprofile-generate") opts.profile_generate = kDefaultProfilePath;
+      else if (arg.rfind("-fprofile-generate=", 0) == 0) opts.profile_generate = arg.substr(19);
+      else if (arg == "-fprofile-use") opts.profile_use = kDefaultProfilePath;
+      else if (arg.rfind("-fprofile-use=", 0) == 0) opts.profile_use = arg.substr(14);
+      // 延迟决定指令调度，也参与缓存键
+      else if (arg.rfind("--lat-mul=", 0) == 0) opts.latency.mul = stoi(arg.substr(10));
+      else if (arg.rfind("--lat-div=", 0) == 0) opts.latency.div = stoi(arg.substr(10));
+      else if (arg.rfind("--lat-load=", 0) == 0) opts.latency.load = stoi(arg.substr(11));
+      opts.flags.push_back(arg);
+    }
+  }
+  return opts;
+}
 
-  assert(argc == 5);
-  auto mode = argv[1];
-  auto input = argv[2];
-  auto output = argv[4];
+static bool EndsWith(const string &str, const string &suffix) {
+  return str.size() >= suffix.size() &&
+         str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// 写到一半的临时产物。断言失败时 abort 不会执行析构和 atexit，由 SIGABRT 处理函数删除它
+static const char *volatile pending_output = nullptr;
 
-  yyin = fopen(input, "r");
-  #ifdef MOD
-  freopen(output, "w", stdout); //stdout -> output
-  #endif
-  assert(yyin);
+static void SetPendingOutput(const char *path) {
+  pending_output = path;
+  if (path) signal(SIGABRT, [](int sig) {
+    if (pending_output) unlink(pending_output);
+    signal(sig, SIG_DFL);
+    raise(sig);
+  });
+}
 
-  unique_ptr<BaseAST> ast;
-  auto ret = yyparse(ast);
-  assert(!ret);
+// 把一次编译的报告追加到 path。整段报告用一次 O_APPEND 写入，
+// 同时编译多个文件并写同一个报告时各段不会交错
+static void AppendReport(const string &path, const string &input, const string &report) {
+  string section = "== " + input + "\n" + report;
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  assert(fd >= 0);
+  ssize_t written = write(fd, section.data(), section.size());
+  assert(written == static_cast<ssize_t>(section.size()));
+  close(fd);
+}
 
-  if (string(mode) == "-koopa") ast->GenIR();
+// --emit=KIND[=PATH],... 在一次解析、一次降级中写出多种产物，KIND 为 tree、koopa 或 riscv；
+// 没有给出 PATH 的产物写到 OUTPUT 加上对应的扩展名。不是 --emit 时返回空
+static vector<pair<string, string>> ParseEmit(const string &mode, const string &output) {
+  vector<pair<string, string>> emits;
+  if (mode.rfind("--emit=", 0) != 0) return emits;
+  static const map<string, string> exts = {{"tree", ".tree"}, {"koopa", ".koopa"}, {"riscv", ".S"}};
+  stringstream ss(mode.substr(7));
+  string item;
+  while (getline(ss, item, ',')) {
+    size_t eq = item.find('=');
+    string kind = item.substr(0, eq);
+    assert(exts.count(kind) && "unknown --emit kind");
+    emits.emplace_back(kind, eq == string::npos ? output + exts.at(kind) : item.substr(eq + 1));
+  }
+  return emits;
+}
 
-  else if (string(mode) == "-riscv") {
-    stringstream ss;
-    streambuf* cout_buf = cout.rdbuf();
-    cout.rdbuf(ss.rdbuf());
+// 把 fn 打印到 cout 的内容写到 out
+static void WriteTo(ostream &out, const function<void()> &fn) {
+  streambuf *cout_buf = cout.rdbuf(out.rdbuf());
+  fn();
+  cout.rdbuf(cout_buf);
+}
 
-    ast->GenIR();
-    string ir_str = ss.str();
-    const char *ir = ir_str.data();
-    cout.rdbuf(cout_buf);
+// 把 GenIR 打印的文本 IR 收集到字符串里
+static string GenIRText(const BaseAST &ast) {
+  stringstream ss;
+  WriteTo(ss, [&] { ast.GenIR(); });
+  return ss.str();
+}
 
+// 由初始化列表直接生成全局数组的数据
+static string ArrayDataAsm(const ArrayData &array) {
+  ostringstream out;
+  size_t count = array.values ? array.values->size() : 0;
+  bool zero = all_of(array.patches.begin(), array.patches.end(), [](const auto &p) { return p.second == 0; });
+  if (count) zero &= all_of(array.values->begin(), array.values->end(), [](int32_t v) { return v == 0; });
+  GlobalHeader(out, array.name.substr(1), zero);
+  {
+    DataWriter data(out);
+    auto patch = array.patches.begin();
+    for (size_t i = 0; i < count; ++i) {
+      if (patch != array.patches.end() && patch->first == i) data.Word((patch++)->second);
+      else data.Word((*array.values)[i]);
+    }
+    data.Zero(4ULL * (array.len - count));
+  }
+  out << "\n";
+  return out.str();
+}
+
+// 文本 IR 经 libkoopa 解析得到的 raw program，析构时释放
+class RawProgram {
+ public:
+  koopa_raw_program_t raw;
+
+  explicit RawProgram(const string &ir_str) {
     koopa_program_t program;
-    koopa_error_code_t ret = koopa_parse_from_string(ir, &program);
+    koopa_error_code_t ret = koopa_parse_from_string(ir_str.c_str(), &program);
     assert(ret == KOOPA_EC_SUCCESS);
-
-    koopa_raw_program_builder_t builder = koopa_new_raw_program_builder();
-    koopa_raw_program_t raw = koopa_build_raw_program(builder, program);
+    builder = koopa_new_raw_program_builder();
+    raw = koopa_build_raw_program(builder, program);
     koopa_delete_program(program);
+  }
+
+  ~RawProgram() { koopa_delete_raw_program_builder(builder); }
+
+ private:
+  koopa_raw_program_builder_t builder;
+};
+
+// 比较文本 IR 与二进制 IR 的大小和加载耗时
+static void BenchIR(const string &ir_str, const koopa_raw_program_t &raw) {
+  const int rounds = 100;
+  stringstream bin_ss;
+  WriteKoopaBinary(raw, bin_ss);
+  string bin_str = bin_ss.str();
+
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < rounds; ++i) RawProgram program(ir_str);
+  auto text_time = chrono::steady_clock::now() - start;
+
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < rounds; ++i) {
+    KoopaBinaryProgram bin;
+    bool loaded = bin.Load(reinterpret_cast<const uint8_t *>(bin_str.data()), bin_str.size());
+    assert(loaded);
+  }
+  auto bin_time = chrono::steady_clock::now() - start;
+
+  auto us = [&](chrono::steady_clock::duration d) {
+    return chrono::duration_cast<chrono::microseconds>(d).count() / rounds;
+  };
+  cout << "text:   " << ir_str.size() << " bytes, " << us(text_time) << " us/load" << endl;
+  cout << "binary: " << bin_str.size() << " bytes, " << us(bin_time) << " us/load";
+}
+
+// 整程序模式：依次降级各个库文件和 input，库文件中的全局变量和函数对之后的文件可见。
+// 拼成的程序去掉 main 用不到的函数和全局变量后，再输出 Koopa IR 或生成代码、解释执行。
+// 只生成汇编时全局数组的初值不经过文本 IR，IR 中只有全 0 的声明，数据由初始化列表直接生成
+static int CompileWholeProgram(const string &mode, const vector<string> &inputs, const char *output,
+                               const Options &opts, ostream *report_out) {
+  string ir_str = library_decls();
+  collect_array_data = mode == "-riscv";
+  map<string, ArrayData> arrays;
+  vector<unique_ptr<BaseAST>> kept;  // 初始化列表所在的数组声明
+  item_sink = [&](unique_ptr<BaseAST> item) {
+    ir_str += GenIRText(*item);
+    if (array_data.empty()) return;
+    for (auto &array : array_data) {
+      ir_str += "global " + array.name + " = alloc [i32, " + to_string(array.len) + "], zeroinit\n";
+      string name = array.name;
+      arrays.emplace(move(name), move(array));
+    }
+    array_data.clear();
+    kept.push_back(move(item));
+  };
+  for (const auto &input : inputs) {
+    FILE *file = fopen(input.c_str(), "r");
+    assert(file);
+    if (opts.check_prescan && !CheckPrescan(file, cerr)) return 1;
+    RestartScanner(file);
+    unique_ptr<BaseAST> ast;
+    auto ret = yyparse(ast);
+    assert(!ret);
+    fclose(file);
+  }
+  item_sink = nullptr;
+
+  RawProgram program(ir_str);
+  ir_str.clear();
+  PrunedProgram pruned(program.raw);
+  int exit_code = 0;
+  freopen(output, mode == "-koopa-bin" ? "wb" : "w", stdout);
+  if (mode == "-koopa") {
+    koopa_program_t koopa;
+    koopa_error_code_t ret = koopa_generate_raw_to_koopa(&pruned.raw, &koopa);
+    assert(ret == KOOPA_EC_SUCCESS);
+    fflush(stdout);
+    koopa_dump_to_stdout(koopa);
+    koopa_delete_program(koopa);
+  } else if (mode == "-riscv") {
+    OrderedTaskPool pool(opts.jobs, cout, report_out);
+    if (pruned.raw.values.len) {
+      pool.Submit([&] {
+        TaskResult result;
+        const auto &values = pruned.raw.values;
+        for (uint32_t i = 0; i < values.len; ++i) {
+          auto value = reinterpret_cast<koopa_raw_value_t>(values.buffer[i]);
+          auto array = arrays.find(value->name);
+          if (array != arrays.end()) result.text += ArrayDataAsm(array->second);
+          else result.text += VisitGlobals({&values.buffer[i], 1, values.kind}).text;
+        }
+        return result;
+      });
+    }
+    VisitProgram(pruned.raw, pool, false);
+    pool.Finish();
+    if (backend_options.profile_generate) cout << ProfileRuntimeAsm(opts.profile_generate);
+    cout << endl;
+  } else if (mode == "-run") {
+    Interpreter interp(pruned.raw, backend_options.profile_generate);
+    exit_code = interp.Run() & 0xff;
+    if (backend_options.profile_generate) interp.WriteProfile(opts.profile_generate);
+  } else if (mode == "-koopa-bin") {
+    WriteKoopaBinary(pruned.raw, cout);
+  } else {
+    assert(false && "--whole-program supports -koopa, -koopa-bin, -riscv and -run");
+  }
+  return exit_code;
+}
+
+static int Compile(int argc, const char *argv[]) {
 
+  assert(argc >= 5);
+  auto mode = argv[1];
+  auto input = argv[2];
+  const char *output = argv[4];
+  Options opts = ParseOptions(argc, argv);
+  vector<pair<string, string>> emits = ParseEmit(mode, output);
+  bool emit_riscv = string(mode) == "-riscv";
+  for (const auto &emit : emits) emit_riscv |= emit.first == "riscv";
+  backend_options.cost_report = !opts.cost_report.empty();
+  backend_options.latency = opts.latency;
+  stringstream report;
+  ostream *report_out = backend_options.cost_report ? &report : nullptr;
+  stringstream temps;
+  if (!opts.temp_report.empty()) temp_report = &temps;
+  backend_options.profile_generate = !opts.profile_generate.empty();
+  Profile profile;
+  if (!opts.profile_use.empty()) {
+    bool loaded = profile.Load(opts.profile_use);
+    assert(loaded && "cannot read profile");
+    backend_options.profile = &profile;
+    // 剖析数据改变输出，它的内容也要参与缓存键
+    string profile_data;
+    ReadWholeFile(opts.profile_use, profile_data);
+    opts.flags.push_back(profile_data);
+  }
+
+  // 命中缓存时直接复制产物，不再解析源文件；-run 的输出依赖标准输入，-bench-ir 的输出是本次测得的耗时，都不缓存；
+  // 代价报告和临时值报告需要实际运行编译，--emit 有多个产物，整程序模式有多个输入，也不走缓存
+  unique_ptr<CompileCache> cache;
+  string cache_key;
+  int exit_code = 0;
+  if (!opts.cache_dir.empty() && string(mode) != "-run" && string(mode) != "-bench-ir" &&
+      opts.cost_report.empty() && opts.temp_report.empty() &&
+      emits.empty() && opts.whole_program.empty()) {
+    string source;
+    if (ReadWholeFile(input, source)) {
+      cache = make_unique<CompileCache>(opts.cache_dir, opts.cache_max_size);
+      cache_key = CompileCache::MakeKey(source, mode, opts.flags);
+      if (cache->Fetch(cache_key, output)) {
+        if (opts.cache_stats) cache->PrintStats(cerr);
+        return 0;
+      }
+    }
+  }
+  // 未命中时先写到临时文件，编译完成后存入缓存再 rename 到 -o，与命中时一样不会留下写了一半的产物。
+  // -o 是设备或符号链接时直接写，产物无法读回，也就不存入缓存
+  string tmp_output;
+  if (cache && CanReplaceFile(output)) {
+    tmp_output = TempPath(output);
+    output = tmp_output.c_str();
+    SetPendingOutput(output);
+  }
+
+  if (!opts.whole_program.empty()) {
+    vector<string> inputs = opts.whole_program;
+    inputs.push_back(input);
+    exit_code = CompileWholeProgram(mode, inputs, output, opts, report_out);
+  }
+
+  // 二进制 IR 已经是降级后的程序，跳过前端直接交给后端
+  else if ((string(mode) == "-riscv" || string(mode) == "-run") && EndsWith(input, ".kbin")) {
+    KoopaBinaryProgram bin;
+    bool loaded = bin.LoadFile(input);
+    assert(loaded);
     freopen(output, "w", stdout);
-    VisitProgram(raw);
-    koopa_delete_raw_program_builder(builder);
+    if (string(mode) == "-run") {
+      Interpreter interp(bin.program, backend_options.profile_generate);
+      exit_code = interp.Run() & 0xff;
+      if (backend_options.profile_generate) interp.WriteProfile(opts.profile_generate);
+    } else {
+      OrderedTaskPool pool(opts.jobs, cout, report_out);
+      VisitProgram(bin.program, pool);
+      pool.Finish();
+      if (backend_options.profile_generate) cout << ProfileRuntimeAsm(opts.profile_generate);
+      cout << endl;
+    }
+  }
+
+  else {
+    yyin = fopen(input, "r");
+    #ifdef MOD
+    if (emits.empty()) freopen(output, "w", stdout); //stdout -> output
+    #endif
+    assert(yyin);
+    if (opts.check_prescan && !CheckPrescan(yyin, cerr)) {
+      if (!tmp_output.empty()) remove(output);
+      return 1;
+    }
+
+    // -koopa/-riscv/-tree 和 --emit 逐函数流水线：每个函数定义或全局声明归约后立即降级、
+    // 生成代码并释放，内存占用以最大的函数为界；其余模式需要整个程序
+    // 生成 RISC-V 时 IR 的解析和后端在线程池上按函数并行，结果仍按源码顺序输出
+    string mode_str = mode;
+    ostream *tree_out = nullptr, *koopa_out = nullptr, *riscv_out = nullptr;
+    vector<unique_ptr<ofstream>> files;
+    for (const auto &[kind, path] : emits) {
+      files.push_back(make_unique<ofstream>(path));
+      assert(*files.back());
+      (kind == "tree" ? tree_out : kind == "koopa" ? koopa_out : riscv_out) = files.back().get();
+    }
+    if (mode_str == "-tree") tree_out = &cout;
+    else if (mode_str == "-koopa") koopa_out = &cout;
+    else if (mode_str == "-riscv") riscv_out = &cout;
+    bool streaming = tree_out || koopa_out || riscv_out;
+
+    // 任务还在使用的全局数组声明，任务完成后在本线程上释放
+    deque<pair<size_t, unique_ptr<BaseAST>>> kept;
+    OrderedTaskPool pool(riscv_out ? opts.jobs : 1, riscv_out ? *riscv_out : cout, report_out);
+    if (tree_out) *tree_out << "CompUnitAST { ";
+    if (koopa_out) *koopa_out << library_decls();
+    if (streaming) {
+      // 每一项只降级一次，文本 IR 同时用于 -koopa 输出和后端。
+      // 函数单独解析时前面补上它用到的全局变量和函数的声明，全局变量的数据只由它自己的声明生成。
+      // 不输出 Koopa IR 时，全局数组的初值不经过文本 IR，直接生成数据
+      collect_array_data = riscv_out && !koopa_out;
+      item_sink = [&, first = true](unique_ptr<BaseAST> item) mutable {
+        if (tree_out) {
+          if (!first) *tree_out << ", ";
+          first = false;
+          WriteTo(*tree_out, [&] { item->Dump(); });
+        }
+        if (riscv_out) {
+          string ir_str = GenIRText(*item);
+          if (koopa_out) *koopa_out << ir_str;
+          bool is_func = dynamic_cast<FuncDefAST *>(item.get());
+          if (is_func) ir_str = used_decls() + ir_str;
+          // array_data 指向 item 中的初始化列表，item 要保留到任务完成。item 由这里保存并在
+          // 本线程上析构，后端线程的栈不必容纳深层语法树的递归析构
+          bool keep = !array_data.empty();
+          size_t id = pool.Submit([ir_str = move(ir_str), is_func, arrays = move(array_data)] {
+            TaskResult result;
+            if (!ir_str.empty()) {
+              RawProgram program(ir_str);
+              result = GenerateAsm(program.raw, !is_func);
+            }
+            for (const auto &array : arrays) result.text += ArrayDataAsm(array);
+            return result;
+          });
+          array_data.clear();
+          if (keep) kept.emplace_back(id, move(item));
+          while (!kept.empty() && kept.front().first < pool.Completed()) kept.pop_front();
+        } else if (koopa_out) {
+          WriteTo(*koopa_out, [&] { item->GenIR(); });
+        }
+      };
+    }
+
+    unique_ptr<BaseAST> ast;
+    auto ret = yyparse(ast);
+    assert(!ret);
+
+    pool.Finish();
+    kept.clear();
+    if (streaming) {
+      if (tree_out) *tree_out << " }" << endl;
+      if (koopa_out) *koopa_out << endl;
+      if (riscv_out) {
+        if (backend_options.profile_generate) *riscv_out << ProfileRuntimeAsm(opts.profile_generate);
+        *riscv_out << endl;
+      }
+    }
+
+    // 直接解释执行降级后的程序，程序输出写入 output，返回值作为退出码
+    else if (mode_str == "-run") {
+      RawProgram program(GenIRText(*ast));
+      ast.reset();
+      Interpreter interp(program.raw, backend_options.profile_generate);
+      exit_code = interp.Run() & 0xff;
+      if (backend_options.profile_generate) interp.WriteProfile(opts.profile_generate);
+    }
+
+    else if (mode_str == "-koopa-bin" || mode_str == "-bench-ir") {
+      string ir_str = GenIRText(*ast);
+      ast.reset();
+      RawProgram program(ir_str);
+      freopen(output, "wb", stdout);
+      if (mode_str == "-koopa-bin") WriteKoopaBinary(program.raw, cout);
+      else BenchIR(ir_str, program.raw);
+    }
+
+    else cout << "I have no idea" << endl;
+    if (!streaming && mode_str != "-koopa-bin" && mode_str != "-run") cout << endl;
   }
 
-  else if (string(mode) == "-tree") ast->Dump();
-  else cout << "I have no idea" << endl;
-  cout << endl;
-  return 0;
-}
\ No newline at end of file
+  if (report_out && emit_riscv) AppendReport(opts.cost_report, input, report.str() + cost_summary.Line());
+  if (temp_report) AppendReport(opts.temp_report, input, temps.str());
+
+  if (cache) {
+    cout.flush();
+    fflush(stdout);
+    if (!tmp_output.empty()) {
+      cache->Store(cache_key, output);
+      rename(output, argv[4]);
+      SetPendingOutput(nullptr);
+    } else {
+      cache->CountMiss();
+    }
+    if (opts.cache_stats) cache->PrintStats(cerr);
+  }
+  cout.flush();
+  return exit_code;
+}
+
+// 语法树的构建、降级、输出和析构都沿树递归，递归深度随嵌套层数和运算链长度增长，
+// 默认 8MB 的栈在十万层左右就会溢出。编译放在栈足够大的线程上，深度只受内存限制。
+// 只有这个线程用大栈，后端线程池仍是默认大小，语法树也只在这个线程上析构
+constexpr size_t kCompileStackSize = size_t(1) << 30;
+
+struct CompileArgs {
+  int argc;
+  const char **argv;
+  int exit_code;
+};
+
+int main(int argc, const char *argv[]) {
+  CompileArgs args{argc, argv, 0};
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, kCompileStackSize);
+  pthread_t compiler;
+  int ret = pthread_create(&compiler, &attr, [](void *p) -> void * {
+    auto args = static_cast<CompileArgs *>(p);
+    args->exit_code = Compile(args->argc, args->argv);
+    return nullptr;
+  }, &args);
+  pthread_attr_destroy(&attr);
+  assert(!ret && "cannot create the compiler thread");
+  pthread_join(compiler, nullptr);
+  return args.exit_code;
+}
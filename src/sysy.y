@@ -13,6 +13,9 @@
 #include <string>
 #include "../include/ast.hpp"
 
+// 分析栈按需从 YYINITDEPTH 倍增，深层嵌套的括号和语句块只受内存限制，不再在默认的 10000 层报错
+#define YYMAXDEPTH 10000000
+
 int yylex();
 void yyerror(std::unique_ptr<BaseAST> &ast, const char *s);
 
@@ -23,117 +26,235 @@ using namespace std;
 %parse-param { std::unique_ptr<BaseAST> &ast }
 
 %union {
-  std::string *str_val;
+  Symbol sym_val;
   int int_val;
   BaseAST *ast_val;
   char op_val;
+  std::vector<Symbol> *syms_val;
 }
 
-%token INT RETURN
-%token <str_val> IDENT
+%token INT VOID CONST IF ELSE WHILE BREAK CONTINUE RETURN
+%token <sym_val> IDENT
 %token <int_val> INT_CONST
 %token AND_OP OR_OP EQ_OP NEQ_OP LE_OP GE_OP
+%token <ast_val> INIT_LIST
 
 
 %left OR_OP
 %left AND_OP
 %left EQ_OP NEQ_OP
-%left LE_OP GE_OP
+%left '<' '>' LE_OP GE_OP
 %left '+' '-'
 %left '*' '/' '%'
-%left '!' 
+%precedence UNARY
+%nonassoc LOWER_THAN_ELSE
+%nonassoc ELSE
 
-%type <ast_val> CompUnit FuncDef FuncType Block Stmt Exp LOrExp LAndExp EqExp RelExp AddExp MulExp UnaryExp PrimaryExp Number
+%type <ast_val> CompUnitItem FuncDef Block BlockItems BlockItem Decl ConstDecl ConstDefs ConstDef VarDecl VarDefs VarDef
+%type <ast_val> InitVal InitExps
+%type <ast_val> Stmt Exp
 %type <op_val> UnaryOp
+%type <syms_val> FuncFParams FuncFParamList
+%type <ast_val> CallArgs
 
 %%
 
 CompUnit
-  : FuncDef {
-    auto comp_unit = std::make_unique<CompUnitAST>(std::unique_ptr<BaseAST>($1));
+  : CompUnitItem {
+    auto comp_unit = std::make_unique<CompUnitAST>();
+    comp_unit->AddItem(std::unique_ptr<BaseAST>($1));
     ast = std::move(comp_unit);
   }
+  | CompUnit CompUnitItem {
+    static_cast<CompUnitAST &>(*ast).AddItem(std::unique_ptr<BaseAST>($2));
+  }
+  ;
+
+CompUnitItem
+  : FuncDef { $$ = $1; }
+  | Decl { $$ = $1; }
   ;
 
+// 返回类型直接写在 FuncDef 里：读到 INT 时还不知道是函数还是变量声明，
+// 单独的 FuncType 会在 INT 之后产生归约/移进冲突
 FuncDef
-  : FuncType IDENT '(' ')' Block {
-    auto func_def = std::make_unique<FuncDefAST>(
-        std::unique_ptr<BaseAST>($1),              
-        *$2,                                      
-        std::unique_ptr<BaseAST>($5));            
-    delete $2;
-    $$ = func_def.release(); 
+  : INT IDENT '(' FuncFParams ')' Block {
+    $$ = new FuncDefAST(std::make_unique<FuncTypeAST>("int"), $2, std::move(*$4), std::unique_ptr<BaseAST>($6));
+    delete $4;
+  }
+  | VOID IDENT '(' FuncFParams ')' Block {
+    $$ = new FuncDefAST(std::make_unique<FuncTypeAST>("void"), $2, std::move(*$4), std::unique_ptr<BaseAST>($6));
+    delete $4;
   }
   ;
 
-FuncType
-  : INT {
-    $$ = new FuncTypeAST("int");
+FuncFParams
+  : %empty { $$ = new std::vector<Symbol>(); }
+  | FuncFParamList { $$ = $1; }
+  ;
+
+FuncFParamList
+  : INT IDENT { $$ = new std::vector<Symbol>{$2}; }
+  | FuncFParamList ',' INT IDENT {
+    $1->push_back($4);
+    $$ = $1;
   }
   ;
 
 Block
-  : '{' Stmt '}' {
-    auto block = std::make_unique<BlockAST>(std::unique_ptr<BaseAST>($2));
-    $$ = block.release();
+  : '{' BlockItems '}' {
+    $$ = $2;
   }
   ;
 
-Stmt
-  : RETURN Exp ';' {
-    $$ = new StmtAST(std::unique_ptr<BaseAST>($2)); 
+BlockItems
+  : %empty {
+    $$ = new BlockAST();
+  }
+  | BlockItems BlockItem {
+    static_cast<BlockAST *>($1)->items.emplace_back($2);
+    $$ = $1;
   }
   ;
 
-Exp
-  : LOrExp { $$ = $1; }
+BlockItem
+  : Decl { $$ = $1; }
+  | Stmt { $$ = $1; }
   ;
 
-LOrExp
-  : LAndExp { $$ = $1; }
-  | LOrExp OR_OP LAndExp { $$ = new LOrExpAST(std::unique_ptr<BaseAST>($1), std::unique_ptr<BaseAST>($3)); }
+Decl
+  : ConstDecl { $$ = $1; }
+  | VarDecl { $$ = $1; }
   ;
 
-LAndExp
-  : EqExp { $$ = $1; }
-  | LAndExp AND_OP EqExp { $$ = new LAndExpAST(std::unique_ptr<BaseAST>($1), std::unique_ptr<BaseAST>($3)); }
+ConstDecl
+  : CONST INT ConstDefs ';' { $$ = $3; }
   ;
 
-EqExp
-  : RelExp { $$ = $1; }
-  | EqExp EQ_OP RelExp { $$ = new EqExpAST(std::unique_ptr<BaseAST>($1), "==", std::unique_ptr<BaseAST>($3)); }
-  | EqExp NEQ_OP RelExp { $$ = new EqExpAST(std::unique_ptr<BaseAST>($1), "!=", std::unique_ptr<BaseAST>($3)); }
+ConstDefs
+  : ConstDef {
+    auto decl = new DeclAST(true);
+    decl->defs.emplace_back($1);
+    $$ = decl;
+  }
+  | ConstDefs ',' ConstDef {
+    static_cast<DeclAST *>($1)->defs.emplace_back($3);
+    $$ = $1;
+  }
   ;
 
-RelExp
-  : AddExp { $$ = $1; }
-  | RelExp '<' AddExp { $$ = new RelExpAST(std::unique_ptr<BaseAST>($1), "<", std::unique_ptr<BaseAST>($3)); }
-  | RelExp '>' AddExp { $$ = new RelExpAST(std::unique_ptr<BaseAST>($1), ">", std::unique_ptr<BaseAST>($3)); }
-  | RelExp LE_OP AddExp { $$ = new RelExpAST(std::unique_ptr<BaseAST>($1), "<=", std::unique_ptr<BaseAST>($3)); }
-  | RelExp GE_OP AddExp { $$ = new RelExpAST(std::unique_ptr<BaseAST>($1), ">=", std::unique_ptr<BaseAST>($3)); }
+ConstDef
+  : IDENT '=' Exp { $$ = new ConstDefAST($1, std::unique_ptr<BaseAST>($3)); }
+  | IDENT '[' Exp ']' '=' InitVal {
+    $$ = new ArrayDefAST($1, true, std::unique_ptr<BaseAST>($3), std::unique_ptr<InitListAST>(static_cast<InitListAST *>($6)));
+  }
   ;
 
-AddExp
-  : MulExp { $$ = $1; }
-  | AddExp '+' MulExp { $$ = new AddExpAST(std::unique_ptr<BaseAST>($1), '+', std::unique_ptr<BaseAST>($3)); }
-  | AddExp '-' MulExp { $$ = new AddExpAST(std::unique_ptr<BaseAST>($1), '-', std::unique_ptr<BaseAST>($3)); }
+VarDecl
+  : INT VarDefs ';' { $$ = $2; }
   ;
 
-MulExp
-  : UnaryExp { $$ = $1; }
-  | MulExp '*' UnaryExp { $$ = new MulExpAST(std::unique_ptr<BaseAST>($1), '*', std::unique_ptr<BaseAST>($3)); }
-  | MulExp '/' UnaryExp { $$ = new MulExpAST(std::unique_ptr<BaseAST>($1), '/', std::unique_ptr<BaseAST>($3)); }
-  | MulExp '%' UnaryExp { $$ = new MulExpAST(std::unique_ptr<BaseAST>($1), '%', std::unique_ptr<BaseAST>($3)); }
+VarDefs
+  : VarDef {
+    auto decl = new DeclAST(false);
+    decl->defs.emplace_back($1);
+    $$ = decl;
+  }
+  | VarDefs ',' VarDef {
+    static_cast<DeclAST *>($1)->defs.emplace_back($3);
+    $$ = $1;
+  }
   ;
 
-UnaryExp
-  : PrimaryExp
-  | UnaryOp UnaryExp { $$ = new UnaryExpAST($1, std::unique_ptr<BaseAST>($2)); }
+VarDef
+  : IDENT { $$ = new VarDefAST($1, nullptr); }
+  | IDENT '=' Exp { $$ = new VarDefAST($1, std::unique_ptr<BaseAST>($3)); }
+  | IDENT '[' Exp ']' { $$ = new ArrayDefAST($1, false, std::unique_ptr<BaseAST>($3), nullptr); }
+  | IDENT '[' Exp ']' '=' InitVal {
+    $$ = new ArrayDefAST($1, false, std::unique_ptr<BaseAST>($3), std::unique_ptr<InitListAST>(static_cast<InitListAST *>($6)));
+  }
+  ;
+
+// 全是整数字面量的列表由词法分析器整个识别为 INIT_LIST，其余的逐个元素归约
+InitVal
+  : INIT_LIST { $$ = $1; }
+  | '{' '}' { $$ = new InitListAST(); }
+  | '{' InitExps '}' { $$ = $2; }
   ;
 
-PrimaryExp
-  : '(' Exp ')' { $$ = $2; }
-  | Number { $$ = $1; }
+InitExps
+  : Exp {
+    auto list = new InitListAST();
+    list->Add(std::unique_ptr<BaseAST>($1));
+    $$ = list;
+  }
+  | InitExps ',' Exp {
+    static_cast<InitListAST *>($1)->Add(std::unique_ptr<BaseAST>($3));
+    $$ = $1;
+  }
+  ;
+
+Stmt
+  : RETURN Exp ';' {
+    $$ = new StmtAST(std::unique_ptr<BaseAST>($2)); 
+  }
+  | RETURN ';' { $$ = new StmtAST(nullptr); }
+  | IDENT '=' Exp ';' { $$ = new AssignStmtAST($1, nullptr, std::unique_ptr<BaseAST>($3)); }
+  | IDENT '[' Exp ']' '=' Exp ';' {
+    $$ = new AssignStmtAST($1, std::unique_ptr<BaseAST>($3), std::unique_ptr<BaseAST>($6));
+  }
+  | Exp ';' { $$ = new ExpStmtAST(std::unique_ptr<BaseAST>($1)); }
+  | ';' { $$ = new ExpStmtAST(nullptr); }
+  | Block { $$ = $1; }
+  | IF '(' Exp ')' Stmt %prec LOWER_THAN_ELSE {
+    $$ = new IfStmtAST(std::unique_ptr<BaseAST>($3), std::unique_ptr<BaseAST>($5), nullptr);
+  }
+  | IF '(' Exp ')' Stmt ELSE Stmt {
+    $$ = new IfStmtAST(std::unique_ptr<BaseAST>($3), std::unique_ptr<BaseAST>($5), std::unique_ptr<BaseAST>($7));
+  }
+  | WHILE '(' Exp ')' Stmt {
+    $$ = new WhileStmtAST(std::unique_ptr<BaseAST>($3), std::unique_ptr<BaseAST>($5));
+  }
+  | BREAK ';' { $$ = new LoopJumpStmtAST(true); }
+  | CONTINUE ';' { $$ = new LoopJumpStmtAST(false); }
+  ;
+
+// 表达式只有一个非终结符，优先级和结合性由 %left 声明决定：
+// 字面量和变量一次归约就成为 Exp，不再逐层经过 LOrExp 到 PrimaryExp
+Exp
+  : INT_CONST { $$ = new NumberAST($1); }
+  | IDENT { $$ = new LValAST($1); }
+  | IDENT '[' Exp ']' { $$ = new LValAST($1, std::unique_ptr<BaseAST>($3)); }
+  | '(' Exp ')' { $$ = $2; }
+  | IDENT '(' ')' { $$ = new CallExpAST($1); }
+  | CallArgs ')' { $$ = $1; }
+  | UnaryOp Exp %prec UNARY { $$ = new UnaryExpAST($1, std::unique_ptr<BaseAST>($2)); }
+  | Exp '*' Exp { $$ = new MulExpAST(std::unique_ptr<BaseAST>($1), '*', std::unique_ptr<BaseAST>($3)); }
+  | Exp '/' Exp { $$ = new MulExpAST(std::unique_ptr<BaseAST>($1), '/', std::unique_ptr<BaseAST>($3)); }
+  | Exp '%' Exp { $$ = new MulExpAST(std::unique_ptr<BaseAST>($1), '%', std::unique_ptr<BaseAST>($3)); }
+  | Exp '+' Exp { $$ = new AddExpAST(std::unique_ptr<BaseAST>($1), '+', std::unique_ptr<BaseAST>($3)); }
+  | Exp '-' Exp { $$ = new AddExpAST(std::unique_ptr<BaseAST>($1), '-', std::unique_ptr<BaseAST>($3)); }
+  | Exp '<' Exp { $$ = new RelExpAST(std::unique_ptr<BaseAST>($1), "<", std::unique_ptr<BaseAST>($3)); }
+  | Exp '>' Exp { $$ = new RelExpAST(std::unique_ptr<BaseAST>($1), ">", std::unique_ptr<BaseAST>($3)); }
+  | Exp LE_OP Exp { $$ = new RelExpAST(std::unique_ptr<BaseAST>($1), "<=", std::unique_ptr<BaseAST>($3)); }
+  | Exp GE_OP Exp { $$ = new RelExpAST(std::unique_ptr<BaseAST>($1), ">=", std::unique_ptr<BaseAST>($3)); }
+  | Exp EQ_OP Exp { $$ = new EqExpAST(std::unique_ptr<BaseAST>($1), "==", std::unique_ptr<BaseAST>($3)); }
+  | Exp NEQ_OP Exp { $$ = new EqExpAST(std::unique_ptr<BaseAST>($1), "!=", std::unique_ptr<BaseAST>($3)); }
+  | Exp AND_OP Exp { $$ = new LAndExpAST(std::unique_ptr<BaseAST>($1), std::unique_ptr<BaseAST>($3)); }
+  | Exp OR_OP Exp { $$ = new LOrExpAST(std::unique_ptr<BaseAST>($1), std::unique_ptr<BaseAST>($3)); }
+  ;
+
+// 调用的函数名和已经读到的实参
+CallArgs
+  : IDENT '(' Exp {
+    auto call = new CallExpAST($1);
+    call->args.emplace_back($3);
+    $$ = call;
+  }
+  | CallArgs ',' Exp {
+    static_cast<CallExpAST *>($1)->args.emplace_back($3);
+    $$ = $1;
+  }
   ;
 
 UnaryOp
@@ -142,10 +263,6 @@ UnaryOp
   | '!' { $$ = '!'; }
   ;
 
-Number
-  : INT_CONST { $$ = new NumberAST($1); }
-  ;
-
 %%
 
 void yyerror(unique_ptr<BaseAST> &ast, const char *s) {
@@ -0,0 +1,19 @@
+// 经过二进制 IR 往返后结果不变：全局变量和数组、常量、循环和调用
+const int N = 8;
+int zeros[100];
+int table[N] = {3, -1, 4, -1, 5, -9, 2, 6};
+int total;
+
+int weigh(int i, int v) { return (i + 1) * v; }
+
+int main() {
+  int i = 0;
+  while (i < N) {
+    zeros[i * 12] = table[i];
+    total = total + weigh(i, table[i]);
+    i = i + 1;
+  }
+  putint(total);
+  putch(10);
+  return zeros[84] + zeros[1] + 0x10 - 010;
+}
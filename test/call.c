@@ -0,0 +1,20 @@
+// 递归调用和超过 8 个参数的调用
+int fib(int n) {
+  if (n < 2) return n;
+  return fib(n - 1) + fib(n - 2);
+}
+
+int sum10(int a, int b, int c, int d, int e, int f, int g, int h, int i, int j) {
+  return a + b * 2 + c * 3 + d * 4 + e * 5 + f * 6 + g * 7 + h * 8 + i * 9 + j * 10;
+}
+
+void show(int x) {
+  putint(x);
+  putch(10);
+}
+
+int main() {
+  show(fib(10));
+  show(sum10(1, 2, 3, 4, 5, 6, 7, 8, 9, 10));
+  return fib(7);
+}
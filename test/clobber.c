@@ -0,0 +1,17 @@
+// 跨过调用仍然活跃的值：放进 s 寄存器，或在冷路径上的调用前后保存恢复
+int id(int x) { return x; }
+
+int main() {
+  int n = getint();
+  int a = n * 3, b = n + 7, c = n - 2, d = n * n;
+  int s = id(a) + id(b) + id(c) + id(d);
+  int i = 0;
+  while (i < n) {
+    s = s + a * id(i) + b - c + d;
+    i = i + 1;
+  }
+  if (n > 100) s = s + id(a) + id(b);
+  putint(s);
+  putch(10);
+  return s % 256;
+}
@@ -0,0 +1,13 @@
+/* 预扫描：块注释、行注释、初始化列表里的注释 **/
+int a[5] = {1, /* two */ 2, // three
+  3, -/**/4,
+  5};		
+
+/*
+ * 跨行的注释
+ ***/ int /**/ main() {   // 行末注释
+  int s = 0, i = 0; /* a // b */
+  while (i < 5) { s = s * 10 + a[i]; i = i + 1; }
+  putint(s); putch(10);
+  return s / 1000;
+} // 没有换行的结尾
\ No newline at end of file
@@ -0,0 +1,14 @@
+// 全局变量的数据段：全零的放进 .bss，其余放进 .data，连续的 0 合并成一条 .zero
+int counter;
+int limit = 7;
+int big[1000];
+int sparse[12] = {0, 0, 5, 0, 0, 0, 0, 0, 9};
+int dense[4] = {1, 2, 3, 4};
+const int kZero = 0;
+int zero_init = kZero;
+
+int main() {
+  big[999] = limit;
+  counter = sparse[2] + sparse[8] + dense[3];
+  return counter + big[999] + zero_init;
+}
@@ -0,0 +1,29 @@
+// -run 解释执行：读入输入、数组、递归，返回值按 8 位截断
+int buf[16];
+
+int gcd(int a, int b) {
+  if (b == 0) return a;
+  return gcd(b, a % b);
+}
+
+int main() {
+  int n = getint();
+  int i = 0;
+  while (i < n) {
+    buf[i] = getint();
+    i = i + 1;
+  }
+  int g = buf[0];
+  i = 1;
+  while (i < n) {
+    g = gcd(g, buf[i]);
+    i = i + 1;
+  }
+  int c = getch();
+  while (c == 32 || c == 10) c = getch();
+  putch(c);
+  putch(10);
+  putint(g);
+  putch(10);
+  return 1000 + g;
+}
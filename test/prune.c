@@ -0,0 +1,11 @@
+// 整程序模式：与 prune.lib.c 一起编译，去掉 main 到不了的函数、全局变量和库函数声明
+int dead_global = 3;
+
+int dead(int x) { return x + dead_global; }
+
+int main() {
+  int v = cube(3) + square(2);
+  putint(calls);
+  putch(10);
+  return v;
+}
@@ -0,0 +1,12 @@
+// prune.c 的库文件：只有 main 用到的函数和全局变量会留下
+int calls;
+int unused_table[256];
+
+int square(int x) {
+  calls = calls + 1;
+  return x * x;
+}
+
+int cube(int x) { return x * square(x); }
+
+int never_called(int x) { return unused_table[x] + cube(x); }
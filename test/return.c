@@ -0,0 +1,19 @@
+// return; 在 int 函数中返回 0，在 void 函数中直接返回
+int pick(int x) {
+  if (x) return;
+  return 5;
+}
+
+void say(int x) {
+  if (x) {
+    putint(x);
+    return;
+  }
+  putch(48);
+}
+
+int main() {
+  say(7);
+  say(0);
+  return pick(1) + pick(0);
+}
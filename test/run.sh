@@ -0,0 +1,67 @@
+#!/bin/sh
+# Compare the compiler's output on every test/NAME.c with the expected files next to it:
+#   NAME.koopa  output of -koopa
+#   NAME.S      output of -riscv
+#   NAME.out    output of -run followed by the exit code on its own line; stdin is NAME.in if present
+# NAME.S and NAME.out are also checked through the binary IR: -koopa-bin, then -riscv/-run on the .kbin.
+# If NAME.lib.c exists, NAME.c is compiled with --whole-program=NAME.lib.c and NAME.lib.c is not a test itself.
+# Every NAME.c must also lex to the same tokens with and without the pre-scan (--check-prescan).
+# Usage: test/run.sh COMPILER
+COMPILER=$1
+DIR=$(dirname "$0")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+failed=0
+
+# check NAME MODE EXPECTED INPUT [FLAGS...]
+check() {
+  name=$1 mode=$2 expected=$3 input=$4
+  shift 4
+  if [ "$mode" = -run ]; then
+    stdin=/dev/null
+    [ -f "$DIR/${name%.kbin}.in" ] && stdin=$DIR/${name%.kbin}.in
+    "$COMPILER" -run "$input" -o "$TMP/run" "$@" < "$stdin"
+    code=$?
+    {
+      cat "$TMP/run"
+      [ -s "$TMP/run" ] && [ -n "$(tail -c 1 "$TMP/run")" ] && echo
+      echo $code
+    } > "$TMP/actual"
+  elif ! "$COMPILER" "$mode" "$input" -o "$TMP/actual" "$@"; then
+    echo "FAIL $name $mode: compiler exited with an error"
+    failed=1
+    return
+  fi
+  if ! cmp -s "$TMP/actual" "$expected"; then
+    echo "FAIL $name $mode"
+    diff "$expected" "$TMP/actual" | head -20
+    failed=1
+  fi
+}
+
+for source in "$DIR"/*.c; do
+  name=$(basename "$source" .c)
+  case $name in *.lib) continue ;; esac
+  set --
+  [ -f "$DIR/$name.lib.c" ] && set -- "--whole-program=$DIR/$name.lib.c"
+  if ! "$COMPILER" -koopa "$source" -o "$TMP/prescan" --check-prescan "$@" 2> "$TMP/prescan.err"; then
+    echo "FAIL $name --check-prescan"
+    cat "$TMP/prescan.err"
+    failed=1
+  fi
+  [ -f "$DIR/$name.koopa" ] && check "$name" -koopa "$DIR/$name.koopa" "$source" "$@"
+  [ -f "$DIR/$name.S" ] && check "$name" -riscv "$DIR/$name.S" "$source" "$@"
+  [ -f "$DIR/$name.out" ] && check "$name" -run "$DIR/$name.out" "$source" "$@"
+  if [ -f "$DIR/$name.S" ] || [ -f "$DIR/$name.out" ]; then
+    if ! "$COMPILER" -koopa-bin "$source" -o "$TMP/$name.kbin" "$@"; then
+      echo "FAIL $name -koopa-bin: compiler exited with an error"
+      failed=1
+      continue
+    fi
+    [ -f "$DIR/$name.S" ] && check "$name.kbin" -riscv "$DIR/$name.S" "$TMP/$name.kbin"
+    [ -f "$DIR/$name.out" ] && check "$name.kbin" -run "$DIR/$name.out" "$TMP/$name.kbin"
+  fi
+done
+
+[ $failed = 0 ] && echo "all tests passed"
+exit $failed
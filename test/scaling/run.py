@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+"""Scaling regression suite.
+
+Generates inputs of sizes N, 2N, 4N and 8N for each pathological shape, compiles each one with
+-riscv, and fails if CPU time or peak memory grows faster than the input.
+
+Growth is measured as the exponent k in cost ~ size^k, fitted between 2N and 8N, where fixed costs
+such as process start-up matter least. Linear scaling gives k <= 1, quadratic gives k close to 2.
+A shape fails when k exceeds --max-exponent (1.5 by default). The margin is deliberate: the
+single-function shapes (huge-function, branches, loops, calls) do linear work, and every backend
+pass runs once per instruction or block. But at 8N their working set is a few hundred MB, far
+past the caches, and even a plain linear pass such as printing the assembly costs about a third
+more per statement, so k(t) can reach 1.3 there. Anything quadratic measures 1.8 or more.
+
+Times are the child's user plus system CPU time, which a loaded host disturbs much less than wall
+time. N is doubled until compiling it takes at least --min-time seconds, and each size is
+compiled at least --repeat times, then again (up to 4x) until the two fastest runs agree within 5%.
+The fastest run is used.
+
+Inputs are generated by a child process (--generate), so this script stays small. Otherwise a
+forked compiler would inherit its memory high-water mark and report it as peak memory.
+
+Usage: test/scaling/run.py COMPILER [--scale S] [--min-time T] [--max-exponent K] [--only SHAPE,...]
+"""
+import argparse
+import math
+import os
+import subprocess
+import sys
+import tempfile
+
+
+def chain(n):
+    return 'int main() { int x = 1; return ' + ' + '.join(['x'] * n) + '; }\n'
+
+
+def unary(n):
+    return 'int main() { int x = getint(); return ' + '- ! ' * n + 'x; }\n'
+
+
+def nested_calls(n):
+    return 'int f(int a) { return a + 1; }\nint main() { int x = getint(); return ' + 'f(' * n + 'x' + ')' * n + \
+           '; }\n'
+
+
+def right_nested(n):
+    return 'int main() { int x = 1; return ' + 'x * (' * n + 'x' + ')' * n + '; }\n'
+
+
+def blocks(n):
+    return 'int main() { int x = 1; ' + '{ int y = x; ' * n + 'x = x + y; ' + '}' * n + ' return x; }\n'
+
+
+def huge_function(n):
+    body = ''.join('  x = x * 3 + %d;\n' % i for i in range(n))
+    return 'int main() {\n  int x = getint();\n' + body + '  return x;\n}\n'
+
+
+def many_globals(n):
+    decls = ''.join('int g%d = %d;\n' % (i, i) for i in range(n))
+    uses = ' + '.join('g%d' % i for i in range(0, n, max(1, n // 64)))
+    return decls + 'int main() { return ' + uses + '; }\n'
+
+
+def many_functions(n):
+    funcs = ''.join('int f%d(int a) { return a + %d; }\n' % (i, i) for i in range(n))
+    return funcs + 'int main() { return f0(1) + f%d(2); }\n' % (n - 1)
+
+
+def branches(n):
+    body = ''.join('  if (x > %d) x = x - 1; else x = x + 2;\n' % i for i in range(n))
+    return 'int main() {\n  int x = getint();\n' + body + '  return x;\n}\n'
+
+
+def loops(n):
+    body = ''.join('  i = 0; while (i < %d) { x = x + i; i = i + 1; }\n' % (k % 7 + 1) for k in range(n))
+    return 'int main() {\n  int x = getint(), i = 0;\n' + body + '  return x;\n}\n'
+
+
+def calls(n):
+    body = ''.join('  x = f(x) + y;\n' for _ in range(n))
+    return 'int f(int a) { return a + 1; }\nint main() {\n  int x = getint(), y = x * 3;\n' + body + \
+           '  return x + y;\n}\n'
+
+
+def huge_comment(n):
+    return '/*' + ' comment ** text\n' * n + '*/\nint main() { return 0; }\n'
+
+
+def long_identifier(n):
+    name = 'v' * n
+    return 'int main() { int %s = 1; return %s; }\n' % (name, name)
+
+
+# 形状名、生成函数、N
+SHAPES = [
+    ('chain', chain, 20000),
+    ('unary', unary, 10000),
+    ('nested-calls', nested_calls, 10000),
+    ('right-nested', right_nested, 10000),
+    ('blocks', blocks, 10000),
+    ('huge-function', huge_function, 5000),
+    ('many-globals', many_globals, 10000),
+    ('many-functions', many_functions, 5000),
+    ('branches', branches, 2000),
+    ('loops', loops, 2000),
+    ('calls', calls, 5000),
+    ('huge-comment', huge_comment, 200000),
+    ('long-identifier', long_identifier, 1000000),
+]
+
+
+def measure(compiler, shape, n, tmp, repeat):
+    """Fastest CPU time in seconds and peak RSS in KB of compiling shape at size n with -riscv."""
+    path = os.path.join(tmp, 'input.c')
+    subprocess.run([sys.executable, __file__, '--generate', shape, str(n), path], check=True)
+    times, best_rss = [], math.inf
+    while len(times) < repeat or (len(times) < 4 * repeat and sorted(times)[1] > 1.05 * min(times)):
+        proc = subprocess.Popen([compiler, '-riscv', path, '-o', os.path.join(tmp, 'out.S')],
+                                stdin=subprocess.DEVNULL, stderr=subprocess.PIPE)
+        _, status, usage = os.wait4(proc.pid, 0)
+        proc.returncode = os.waitstatus_to_exitcode(status)
+        if proc.returncode != 0:
+            raise RuntimeError('compiler exited with %d: %s' % (proc.returncode, proc.stderr.read().decode()[-500:]))
+        times.append(usage.ru_utime + usage.ru_stime)
+        best_rss = min(best_rss, usage.ru_maxrss)
+    return min(times), best_rss
+
+
+def exponent(small, large, ratio):
+    """k in cost ~ size^k between two sizes ratio apart."""
+    return math.log(max(large, 1e-9) / max(small, 1e-9)) / math.log(ratio)
+
+
+def main():
+    if len(sys.argv) == 5 and sys.argv[1] == '--generate':
+        generate = dict((name, generate) for name, generate, _ in SHAPES)[sys.argv[2]]
+        with open(sys.argv[4], 'w') as f:
+            f.write(generate(int(sys.argv[3])))
+        return 0
+
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('compiler')
+    parser.add_argument('--scale', type=float, default=1.0, help='multiply every N by this factor')
+    parser.add_argument('--min-time', type=float, default=0.1, help='smallest time in seconds for N')
+    parser.add_argument('--max-exponent', type=float, default=1.5)
+    parser.add_argument('--repeat', type=int, default=3, help='at least 2')
+    parser.add_argument('--only', default='', help='comma-separated shape names')
+    args = parser.parse_args()
+    only = set(filter(None, args.only.split(',')))
+
+    failed = []
+    with tempfile.TemporaryDirectory() as tmp:
+        print('%-16s %8s %10s %10s %10s %10s   %6s %6s' % ('shape', 'N', '@N', '@2N', '@4N', '@8N', 'k(t)', 'k(mem)'))
+        for name, _, n in SHAPES:
+            if only and name not in only:
+                continue
+            n = max(1, int(n * args.scale))
+            try:
+                results = [measure(args.compiler, name, n, tmp, args.repeat)]
+                while results[0][0] < args.min_time:
+                    n *= 2
+                    results = [measure(args.compiler, name, n, tmp, args.repeat)]
+                results += [measure(args.compiler, name, n * m, tmp, args.repeat) for m in (2, 4, 8)]
+            except RuntimeError as error:
+                print('%-16s FAIL %s' % (name, error))
+                failed.append(name)
+                continue
+            k_time = exponent(results[1][0], results[3][0], 4)
+            k_mem = exponent(results[1][1], results[3][1], 4)
+            print('%-16s %8d %s   %6.2f %6.2f' % (name, n, ' '.join('%9.3fs' % t for t, _ in results), k_time, k_mem))
+            print('%-16s %8s %s' % ('', '', ' '.join('%8dKB' % rss for _, rss in results)))
+            if k_time > args.max_exponent or k_mem > args.max_exponent:
+                failed.append(name)
+
+    if failed:
+        print('super-linear scaling: ' + ', '.join(failed))
+        return 1
+    print('all shapes scale linearly')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
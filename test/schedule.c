@@ -0,0 +1,18 @@
+// 表调度：把不相关的指令挪到 lw、mul、div 和使用其结果的指令之间
+int a[16];
+
+int main() {
+  int i = 0, s = 0;
+  while (i < 16) {
+    a[i] = getint();
+    i = i + 1;
+  }
+  i = 0;
+  while (i < 16) {
+    s = s + a[i] * a[15 - i] + a[(i + 1) % 16] * 3 - a[(i + 5) % 16] / 7;
+    i = i + 1;
+  }
+  putint(s);
+  putch(10);
+  return s % 256;
+}
@@ -0,0 +1,21 @@
+// || 和 && 短路求值：右侧的调用和越界访问不会执行
+int calls = 0;
+int a[4] = {1, 2, 3, 4};
+
+int f(int v) {
+  calls = calls + 1;
+  return v;
+}
+
+int main() {
+  int i = 4, s = 0;
+  if (f(1) || f(2)) s = s + 1;
+  if (f(0) && f(3)) s = s + 10;
+  if (i < 4 && a[i]) s = s + 100;
+  int j = 0;
+  while (j < 4 && a[j] != 3) j = j + 1;
+  s = s + (f(0) || f(0) || f(5)) * 1000;
+  putint(calls);
+  putch(10);
+  return s + j;
+}